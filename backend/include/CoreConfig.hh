@@ -53,6 +53,7 @@ public:
   static const std::string CFG_KEY_DISTRIBUTION_ENABLED;
   static const std::string CFG_KEY_DISTRIBUTION_LISTENING;
   static const std::string CFG_KEY_DISTRIBUTION_PEERS;
+  static const std::string CFG_KEY_DISTRIBUTION_DISCOVERY;
   static const std::string CFG_KEY_DISTRIBUTION_TCP;
   static const std::string CFG_KEY_DISTRIBUTION_TCP_PORT;
   static const std::string CFG_KEY_DISTRIBUTION_TCP_USERNAME;
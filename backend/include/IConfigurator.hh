@@ -42,6 +42,9 @@ namespace workrave {
       CONFIG_FLAG_IMMEDIATE = 2,
     };
 
+  //! Handle of a configuration key, see IConfigurator::resolve_key.
+  typedef int ConfigKeyHandle;
+
 
   //! Interface to access the configuration.
   class IConfigurator
@@ -63,6 +66,15 @@ namespace workrave {
     virtual bool get_value(const std::string &key, int &out) const = 0;
     virtual bool get_value(const std::string &key, double &out) const = 0;
 
+    //! Returns a handle for fast repeated reads of the specified key.
+    /*! The handle remains valid for the lifetime of the configurator. */
+    virtual ConfigKeyHandle resolve_key(const std::string &key) = 0;
+
+    virtual bool get_value(ConfigKeyHandle key, std::string &out) const = 0;
+    virtual bool get_value(ConfigKeyHandle key, bool &out) const = 0;
+    virtual bool get_value(ConfigKeyHandle key, int &out) const = 0;
+    virtual bool get_value(ConfigKeyHandle key, double &out) const = 0;
+
     virtual void get_value_with_default(const std::string &key, std::string &out, std::string s) const = 0;
     virtual void get_value_with_default(const std::string &key, bool &out, const bool def) const = 0;
     virtual void get_value_with_default(const std::string &key, int &out, const int def) const = 0;
@@ -81,6 +93,30 @@ namespace workrave {
     virtual bool remove_listener(IConfiguratorListener *listener) = 0;
     virtual bool remove_listener(const std::string &key_prefix, IConfiguratorListener *listener) = 0;
     virtual bool find_listener(IConfiguratorListener *listener, std::string &key) const = 0;
+
+    //! Defers change notifications until the matching end_batch.
+    /*!
+     *  Batches may be nested. When the outermost batch ends, each
+     *  listener is notified once with all changed keys it listens to.
+     */
+    virtual void begin_batch() = 0;
+    virtual void end_batch() = 0;
+
+    //! Starts collecting values instead of setting them.
+    /*!
+     *  Values set in a transaction are not visible until the transaction
+     *  is committed. Returns false if a transaction is already active.
+     */
+    virtual bool begin_transaction() = 0;
+
+    //! Sets all values of the transaction, notifies listeners once and saves once.
+    virtual bool commit_transaction() = 0;
+
+    //! Discards all values of the transaction.
+    virtual void rollback_transaction() = 0;
+
+    //! Sets all values, specified as "type:value", in a single transaction.
+    virtual bool apply_settings(const std::map<std::string, std::string> &settings) = 0;
   };
 }
 
@@ -18,6 +18,7 @@
 #define ICONFIGURATORLISTENER_HH
 
 #include <string>
+#include <set>
 
 namespace workrave
 {
@@ -29,6 +30,19 @@ namespace workrave
 
     //! The configuration item with specified key has changed.
     virtual void config_changed_notify(const std::string &key) = 0;
+
+    //! The configuration items with the specified keys have changed in a single batch.
+    /*!
+     *  Called once per batch instead of config_changed_notify. The
+     *  default implementation notifies each key separately.
+     */
+    virtual void config_batch_changed_notify(const std::set<std::string> &keys)
+    {
+      for (std::set<std::string>::const_iterator i = keys.begin(); i != keys.end(); i++)
+        {
+          config_changed_notify(*i);
+        }
+    }
   };
 }
 
@@ -88,6 +88,17 @@ namespace workrave {
     //! Periodic heartbeat. The GUI *MUST* call this method every second.
     virtual void heartbeat() = 0;
 
+    //! Returns the time of the next heartbeat that has any effect.
+    /*!
+     *  A return value of 0 means that a heartbeat is needed every second. Otherwise,
+     *  the GUI may skip all heartbeats until the returned time, or until it receives
+     *  a wakeup from the ICoreEventListener.
+     */
+    virtual time_t get_next_heartbeat_time() const = 0;
+
+    //! Returns the number of heartbeats during the last hour.
+    virtual int get_heartbeats_per_hour() const = 0;
+
     //! Force a break of the specified type.
     virtual void force_break(BreakId id, BreakHint break_hint) = 0;
 
@@ -54,6 +54,10 @@ namespace workrave
 
     // Notification that the usage mode has changed..
     virtual void core_event_usage_mode_changed(const UsageMode m) = 0;
+
+    // Request for a heartbeat as soon as possible. This is the only
+    // notification that may be called from a thread other than the main thread.
+    virtual void core_event_wakeup() = 0;
   };
 }
 
@@ -21,6 +21,8 @@
 #define IDISTRIBUTIOMANAGER_HH
 
 #include <string>
+#include <list>
+#include <map>
 using namespace std;
 
 namespace workrave
@@ -34,6 +36,7 @@ namespace workrave
 
     virtual bool is_master() const = 0;
     virtual int get_number_of_peers() = 0;
+    virtual map<string, int> get_peer_queue_sizes() = 0;
     virtual bool connect(string url) = 0;
 
     virtual bool disconnect_all() = 0;
@@ -55,6 +58,9 @@ namespace workrave
     virtual bool get_listening() const = 0;
     virtual void set_listening(bool b) = 0;
 
+    virtual bool get_discovery() const = 0;
+    virtual void set_discovery(bool b) = 0;
+
     virtual string get_username() const = 0;
     virtual void set_username(string name) = 0;
 
@@ -76,6 +76,22 @@ namespace workrave {
       MiscStats misc_stats;
     };
 
+    //! Totals of the statistics of a range of days.
+    struct RangeStats
+    {
+      //! Number of days in the range that have statistics.
+      int day_count;
+
+      //! Is the current day part of the range?
+      bool includes_current_day;
+
+      //! Total statistics of each break
+      int64_t break_stats[BREAK_ID_SIZEOF][STATS_BREAKVALUE_SIZEOF];
+
+      //! Total misc statistics
+      int64_t misc_stats[STATS_VALUE_SIZEOF];
+    };
+
   public:
     virtual ~IStatistics() {}
 
@@ -85,6 +101,20 @@ namespace workrave {
     virtual DailyStats *get_day(int day) const = 0;
     virtual void get_day_index_by_date(int y, int m, int d, int &idx, int &next, int &prev) const = 0;
     virtual int get_history_size() const = 0;
+
+    //! Returns the totals of all days from y1/m1/d1 up to and including y2/m2/d2.
+    virtual void get_range_stats(int y1, int m1, int d1, int y2, int m2, int d2, RangeStats &stats) const = 0;
+
+    //! Returns the totals of the week that contains y/m/d.
+    /*! \param week_start first day of the week, 0 is Sunday. */
+    virtual void get_week_stats(int y, int m, int d, int week_start, RangeStats &stats) const = 0;
+
+    //! Returns the totals of month m of year y.
+    virtual void get_month_stats(int y, int m, RangeStats &stats) const = 0;
+
+    //! Returns the totals of year y.
+    virtual void get_year_stats(int y, RangeStats &stats) const = 0;
+
     virtual void dump() = 0;
   };
 }
@@ -55,7 +55,8 @@ ActivityMonitor::ActivityMonitor() :
   prev_y(-10),
   button_is_pressed(false),
   sensitivity(3),
-  listener(NULL)
+  listener(NULL),
+  wakeup_listener(NULL)
 {
   TRACE_ENTER("ActivityMonitor::ActivityMonitor");
 
@@ -176,6 +177,14 @@ ActivityMonitor::get_current_state()
         }
     }
 
+  if ((activity_state == ACTIVITY_IDLE || activity_state == ACTIVITY_NOISE) &&
+      input_monitor != NULL)
+    {
+      // The next input event may change the state. Make sure the core
+      // is woken up by it.
+      input_monitor->request_wakeup();
+    }
+
   lock.unlock();
   TRACE_RETURN(activity_state);
   return activity_state;
@@ -245,15 +254,90 @@ ActivityMonitor::set_listener(ActivityMonitorListener *l)
 }
 
 
-//! Activity is reported by the input monitor.
+//! Sets the listener that is notified of the first activity after being idle.
+/*!
+ *  The listener is called from the thread of the input monitor.
+ */
+void
+ActivityMonitor::set_wakeup_listener(ActivityMonitorListener *l)
+{
+  lock.lock();
+  wakeup_listener = l;
+  lock.unlock();
+}
+
+
+//! Processes all input events queued by the input monitor.
+void
+ActivityMonitor::process_events()
+{
+  if (input_monitor != NULL)
+    {
+      input_monitor->dispatch_events();
+    }
+}
+
+
+//! A batch of input events is reported by the input monitor.
+void
+ActivityMonitor::input_events_notify(const InputEvent *events, int count)
+{
+  bool active = false;
+
+  lock.lock();
+  for (int i = 0; i < count; i++)
+    {
+      const InputEvent &event = events[i];
+
+      switch (event.type)
+        {
+        case INPUT_EVENT_ACTION:
+          active |= process_action(event.time);
+          break;
+
+        case INPUT_EVENT_MOUSE:
+          active |= process_mouse(event.x, event.y, event.wheel, event.time);
+          break;
+
+        case INPUT_EVENT_BUTTON:
+          active |= process_button(event.flag, event.time);
+          break;
+
+        case INPUT_EVENT_KEYBOARD:
+          active |= process_action(event.time);
+          break;
+        }
+    }
+  lock.unlock();
+
+  if (active)
+    {
+      call_listener();
+    }
+}
+
+
+//! The first input event after a wakeup request is reported by the input monitor.
 void
-ActivityMonitor::action_notify()
+ActivityMonitor::wakeup_notify()
 {
+  ActivityMonitorListener *l = NULL;
+
   lock.lock();
+  l = wakeup_listener;
+  lock.unlock();
+
+  if (l != NULL)
+    {
+      l->action_notify();
+    }
+}
 
-  GTimeVal now;
-  g_get_current_time(&now);
 
+//! Processes user activity at the specified time.
+bool
+ActivityMonitor::process_action(const GTimeVal &now)
+{
   switch (activity_state)
     {
     case ACTIVITY_IDLE:
@@ -297,16 +381,15 @@ ActivityMonitor::action_notify()
     }
 
   last_action_time = now;
-  lock.unlock();
-  call_listener();
+  return true;
 }
 
 
-//! Mouse activity is reported by the input monitor.
-void
-ActivityMonitor::mouse_notify(int x, int y, int wheel_delta)
+//! Processes mouse movement at the specified time.
+bool
+ActivityMonitor::process_mouse(int x, int y, int wheel_delta, const GTimeVal &now)
 {
-  lock.lock();
+  bool ret = false;
   const int delta_x = x - prev_x;
   const int delta_y = y - prev_y;
   prev_x = x;
@@ -315,38 +398,27 @@ ActivityMonitor::mouse_notify(int x, int y, int wheel_delta)
   if (abs(delta_x) >= sensitivity || abs(delta_y) >= sensitivity
       || wheel_delta != 0 || button_is_pressed)
     {
-      action_notify();
+      ret = process_action(now);
     }
-  lock.unlock();
+
+  return ret;
 }
 
 
-//! Mouse button activity is reported by the input monitor.
-void
-ActivityMonitor::button_notify(bool is_press)
+//! Processes a mouse button press or release at the specified time.
+bool
+ActivityMonitor::process_button(bool is_press, const GTimeVal &now)
 {
-  lock.lock();
+  bool ret = false;
 
   button_is_pressed = is_press;
 
   if (is_press)
     {
-      action_notify();
+      ret = process_action(now);
     }
 
-  lock.unlock();
-}
-
-
-//! Keyboard activity is reported by the input monitor.
-void
-ActivityMonitor::keyboard_notify(bool repeat)
-{
-  (void)repeat;
-
-  lock.lock();
-  action_notify();
-  lock.unlock();
+  return ret;
 }
 
 
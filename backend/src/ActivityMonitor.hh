@@ -22,6 +22,7 @@
 
 #include "IActivityMonitor.hh"
 #include "IInputMonitorListener.hh"
+#include "InputEventRing.hh"
 #include "Mutex.hh"
 
 #if TIME_WITH_SYS_TIME
@@ -58,13 +59,18 @@ public:
   void get_parameters(int &noise, int &activity, int &idle, int &sensitivity);
 
   void set_listener(ActivityMonitorListener *l);
+  void set_wakeup_listener(ActivityMonitorListener *l);
 
-  void action_notify();
-  void mouse_notify(int x, int y, int wheel = 0);
-  void button_notify(bool is_press);
-  void keyboard_notify(bool repeat);
+  void process_events();
+
+  // IInputMonitorListener
+  void input_events_notify(const InputEvent *events, int count);
+  void wakeup_notify();
 
 private:
+  bool process_action(const GTimeVal &now);
+  bool process_mouse(int x, int y, int wheel_delta, const GTimeVal &now);
+  bool process_button(bool is_press, const GTimeVal &now);
   void call_listener();
 
 private:
@@ -106,6 +112,9 @@ private:
 
   //! Activity listener.
   ActivityMonitorListener *listener;
+
+  //! Listener for the first activity after being idle.
+  ActivityMonitorListener *wakeup_listener;
 };
 
 #endif // ACTIVITYMONITOR_HH
@@ -79,6 +79,13 @@ struct Defaults
 Break::Break() :
   break_id(BREAK_ID_NONE),
   config(NULL),
+  key_timer_limit(-1),
+  key_timer_auto_reset(-1),
+  key_timer_reset_pred(-1),
+  key_timer_snooze(-1),
+  key_timer_monitor(-1),
+  key_break_max_preludes(-1),
+  key_break_enabled(-1),
   application(NULL),
   timer(NULL),
   break_control(NULL),
@@ -90,6 +97,20 @@ Break::Break() :
 }
 
 
+//! Resolves the configuration keys that are read on every reload.
+void
+Break::init_keys()
+{
+  key_timer_limit = config->resolve_key(CoreConfig::CFG_KEY_TIMER_LIMIT % break_id);
+  key_timer_auto_reset = config->resolve_key(CoreConfig::CFG_KEY_TIMER_AUTO_RESET % break_id);
+  key_timer_reset_pred = config->resolve_key(CoreConfig::CFG_KEY_TIMER_RESET_PRED % break_id);
+  key_timer_snooze = config->resolve_key(CoreConfig::CFG_KEY_TIMER_SNOOZE % break_id);
+  key_timer_monitor = config->resolve_key(CoreConfig::CFG_KEY_TIMER_MONITOR % break_id);
+  key_break_max_preludes = config->resolve_key(CoreConfig::CFG_KEY_BREAK_MAX_PRELUDES % break_id);
+  key_break_enabled = config->resolve_key(CoreConfig::CFG_KEY_BREAK_ENABLED % break_id);
+}
+
+
 //! Initializes the break.
 void
 Break::init(BreakId id, IApp *app)
@@ -107,9 +128,13 @@ Break::init(BreakId id, IApp *app)
   timer->set_id(break_name);
   break_control = new BreakControl(break_id, app, timer);
 
+  init_keys();
   init_timer();
   init_break_control();
+
+  config->begin_batch();
   init_defaults();
+  config->end_batch();
 
   TRACE_EXIT()
 }
@@ -272,19 +297,19 @@ Break::load_timer_config()
   TRACE_ENTER("Break::load_timer_config");
   // Read break limit.
   int limit;
-  config->get_value(CoreConfig::CFG_KEY_TIMER_LIMIT % break_id, limit);
+  config->get_value(key_timer_limit, limit);
   timer->set_limit(limit);
   timer->set_limit_enabled(limit > 0);
 
   // Read autoreset interval
   int autoreset;
-  config->get_value(CoreConfig::CFG_KEY_TIMER_AUTO_RESET % break_id, autoreset);
+  config->get_value(key_timer_auto_reset, autoreset);
   timer->set_auto_reset(autoreset);
   timer->set_auto_reset_enabled(autoreset > 0);
 
   // Read reset predicate
   string reset_pred;
-  config->get_value(CoreConfig::CFG_KEY_TIMER_RESET_PRED % break_id, reset_pred);
+  config->get_value(key_timer_reset_pred, reset_pred);
   if (reset_pred != "")
     {
       timer->set_auto_reset(reset_pred);
@@ -292,13 +317,13 @@ Break::load_timer_config()
 
   // Read the snooze time.
   int snooze;
-  config->get_value(CoreConfig::CFG_KEY_TIMER_SNOOZE % break_id, snooze);
+  config->get_value(key_timer_snooze, snooze);
   timer->set_snooze_interval(snooze);
 
   // Load the monitor setting for the timer.
   string monitor_name;
 
-  bool ret = config->get_value(CoreConfig::CFG_KEY_TIMER_MONITOR % break_id, monitor_name);
+  bool ret = config->get_value(key_timer_monitor, monitor_name);
 
   TRACE_MSG(ret << " " << monitor_name);
   if (ret && monitor_name != "")
@@ -334,12 +359,12 @@ Break::load_break_control_config()
 {
   // Maximum number of prelude windows.
   int max_preludes;
-  config->get_value(CoreConfig::CFG_KEY_BREAK_MAX_PRELUDES % break_id, max_preludes);
+  config->get_value(key_break_max_preludes, max_preludes);
   break_control->set_max_preludes(max_preludes);
 
   // Break enabled?
   enabled = true;
-  config->get_value(CoreConfig::CFG_KEY_BREAK_ENABLED % break_id, enabled);
+  config->get_value(key_break_enabled, enabled);
 }
 
 
@@ -347,12 +372,12 @@ void
 Break::override(BreakId id)
 {
   int max_preludes;
-  config->get_value(CoreConfig::CFG_KEY_BREAK_MAX_PRELUDES % break_id, max_preludes);
+  config->get_value(key_break_max_preludes, max_preludes);
 
   if (break_id != id)
     {
       int override_max_preludes;
-      config->get_value(CoreConfig::CFG_KEY_BREAK_MAX_PRELUDES % id, override_max_preludes);
+      config->get_value(config->resolve_key(CoreConfig::CFG_KEY_BREAK_MAX_PRELUDES % id), override_max_preludes);
       if (override_max_preludes != -1 && override_max_preludes < max_preludes)
         {
           max_preludes = override_max_preludes;
@@ -493,3 +518,36 @@ Break::config_changed_notify(const string &key)
     }
   TRACE_EXIT();
 }
+
+
+//! Notification that a batch of configuration changed.
+void
+Break::config_batch_changed_notify(const set<string> &keys)
+{
+  TRACE_ENTER_MSG("Break::config_batch_changed_notify", keys.size());
+  bool break_changed = false;
+  bool timer_changed = false;
+
+  for (set<string>::const_iterator i = keys.begin(); i != keys.end(); i++)
+    {
+      string name;
+      if (starts_with(*i, CoreConfig::CFG_KEY_BREAKS, name))
+        {
+          break_changed = true;
+        }
+      else if (starts_with(*i, CoreConfig::CFG_KEY_TIMERS, name))
+        {
+          timer_changed = true;
+        }
+    }
+
+  if (break_changed)
+    {
+      load_break_control_config();
+    }
+  if (timer_changed)
+    {
+      load_timer_config();
+    }
+  TRACE_EXIT();
+}
@@ -21,6 +21,7 @@
 #define BREAK_HH
 
 #include "ICore.hh"
+#include "IConfigurator.hh"
 #include "IConfiguratorListener.hh"
 #include "IBreak.hh"
 #include "Timer.hh"
@@ -53,6 +54,15 @@ private:
   //! The Configurator
   IConfigurator *config;
 
+  //! Handles of the configuration keys that are read repeatedly.
+  ConfigKeyHandle key_timer_limit;
+  ConfigKeyHandle key_timer_auto_reset;
+  ConfigKeyHandle key_timer_reset_pred;
+  ConfigKeyHandle key_timer_snooze;
+  ConfigKeyHandle key_timer_monitor;
+  ConfigKeyHandle key_break_max_preludes;
+  ConfigKeyHandle key_break_enabled;
+
   //!
   IApp *application;
 
@@ -103,8 +113,10 @@ public:
 
 private:
   void config_changed_notify(const std::string &key);
+  void config_batch_changed_notify(const std::set<std::string> &keys);
 
 private:
+  void init_keys();
   void init_defaults();
 
   void init_timer();
@@ -28,6 +28,7 @@
 #include "debug.hh"
 #include <cstdlib>
 #include <sstream>
+#include <algorithm>
 
 #include "Configurator.hh"
 
@@ -44,6 +45,11 @@ using namespace workrave;
 Configurator::Configurator(IConfigBackend *backend)
 {
   this->auto_save_time = 0;
+  this->cache_generation = 1;
+  this->next_listener_serial = 0;
+  this->batch_depth = 0;
+  this->in_transaction = false;
+  this->listener_trie.resize(1);
   this->backend = backend;
   if (dynamic_cast<IConfigBackendMonitoring *>(backend) != NULL)
     {
@@ -62,6 +68,7 @@ Configurator::~Configurator()
 bool
 Configurator::load(std::string filename)
 {
+  invalidate_cache();
   return backend->load(filename);
 }
 
@@ -92,40 +99,48 @@ Configurator::heartbeat()
   ICore *core = CoreFactory::get_core();
   time_t now = core->get_time();
 
-  DelayedListIter it = delayed_config.begin();
-  while (it != delayed_config.end())
+  begin_batch();
+
+  while (!delayed_deadlines.empty() && now >= delayed_deadlines.front().until)
     {
-      DelayedConfig &delayed = it->second;
-      DelayedListIter next = it;
-      next++;
+      DelayedDeadline deadline = delayed_deadlines.front();
+      pop_heap(delayed_deadlines.begin(), delayed_deadlines.end(), DelayedDeadlineLater());
+      delayed_deadlines.pop_back();
 
-      if (now >= delayed.until)
+      DelayedListIter it = delayed_config.find(deadline.key);
+      if (it == delayed_config.end() || it->second.until != deadline.until)
         {
-          Variant old_value;
-          bool old_value_valid = backend->get_value(delayed.key, delayed.value.type, old_value);
+          // Stale deadline.
+          continue;
+        }
+
+      DelayedConfig &delayed = it->second;
 
+      Variant old_value;
+      bool old_value_valid = backend->get_value(delayed.key, delayed.value.type, old_value);
+
+      // Changes that end at the original value need not be written.
+      if (!old_value_valid || old_value != delayed.value)
+        {
           bool b = backend->set_value(delayed.key, delayed.value);
+          invalidate_cache(delayed.key);
 
           if (b && dynamic_cast<IConfigBackendMonitoring *>(backend) == NULL)
             {
-              if (!old_value_valid || old_value != delayed.value)
-                {
-                  fire_configurator_event(delayed.key);
+              fire_configurator_event(delayed.key);
 
-                  if (auto_save_time == 0)
-                    {
-                      ICore *core = CoreFactory::get_core();
-                      auto_save_time = core->get_time() + 30;
-                    }
+              if (auto_save_time == 0)
+                {
+                  auto_save_time = now + 30;
                 }
             }
-
-          delayed_config.erase(it);
         }
 
-      it = next;
+      delayed_config.erase(it);
     }
 
+  end_batch();
+
   if (auto_save_time != 0 && now >= auto_save_time)
     {
       save();
@@ -134,6 +149,26 @@ Configurator::heartbeat()
 }
 
 
+//! Returns the next time heartbeat() has work to do, or 0 if there is none.
+time_t
+Configurator::get_next_deadline() const
+{
+  time_t next = auto_save_time;
+
+  // A stale deadline on top only causes an early heartbeat.
+  if (!delayed_deadlines.empty())
+    {
+      time_t until = delayed_deadlines.front().until;
+      if (next == 0 || until < next)
+        {
+          next = until;
+        }
+    }
+
+  return next;
+}
+
+
 void
 Configurator::set_delay(const std::string &key, int delay)
 {
@@ -156,6 +191,7 @@ Configurator::set_delay(const std::string &key, int delay)
 bool
 Configurator::remove_key(const std::string &key) const
 {
+  invalidate_cache(key);
   return backend->remove_key(key);
 }
 
@@ -197,6 +233,21 @@ Configurator::set_value(const std::string &key, Variant &value, ConfigFlags flag
 
   TRACE_ENTER_MSG("Configurator::set_value", key);
 
+  if (in_transaction)
+    {
+      newkey = key;
+      strip_trailing_slash(newkey);
+      strip_leading_slash(newkey);
+
+      TransactionValue &t = transaction_values[newkey];
+      t.key = newkey;
+      t.value = value;
+      t.flags = flags;
+
+      TRACE_EXIT();
+      return true;
+    }
+
   if ((flags & CONFIG_FLAG_DEFAULT) != 0)
     {
       skip = get_value(key, value.type, value);
@@ -218,11 +269,24 @@ Configurator::set_value(const std::string &key, Variant &value, ConfigFlags flag
             {
               ICore *core = CoreFactory::get_core();
 
+              time_t until = core->get_time() + setting.delay;
+
+              // Repeated changes within the delay are coalesced into a single write.
               DelayedConfig &d = delayed_config[key];
+              if (d.key.empty() || d.until != until)
+                {
+                  DelayedDeadline deadline;
+                  deadline.until = until;
+                  deadline.key = key;
+                  delayed_deadlines.push_back(deadline);
+                  push_heap(delayed_deadlines.begin(), delayed_deadlines.end(), DelayedDeadlineLater());
+                }
+
               d.key = (string)key;
               d.value = value;
-              d.until = core->get_time() + setting.delay;
+              d.until = until;
 
+              invalidate_cache(newkey);
               skip = true;
             }
         }
@@ -234,6 +298,7 @@ Configurator::set_value(const std::string &key, Variant &value, ConfigFlags flag
       bool old_value_valid = backend->get_value(newkey, value.type, old_value);
 
       ret = backend->set_value(newkey, value);
+      invalidate_cache(newkey);
 
       if (ret && dynamic_cast<IConfigBackendMonitoring *>(backend) == NULL)
         {
@@ -352,6 +417,135 @@ Configurator::get_value(const std::string &key, double &out) const
 }
 
 
+//! Returns a handle for fast repeated reads of the specified key.
+/*!
+ *  Reads through a handle are served from a cache until the key is
+ *  changed, either through the configurator or by the backend.
+ */
+ConfigKeyHandle
+Configurator::resolve_key(const std::string &key)
+{
+  string newkey = key;
+  strip_trailing_slash(newkey);
+  strip_leading_slash(newkey);
+
+  KeyHandles::iterator it = key_handles.find(newkey);
+  if (it != key_handles.end())
+    {
+      return it->second;
+    }
+
+  CachedValue cached;
+  cached.key = newkey;
+  cached.generation = 0;
+  cached.type = VARIANT_TYPE_NONE;
+  cached.found = false;
+
+  ConfigKeyHandle handle = key_cache.size();
+  key_cache.push_back(cached);
+  key_handles[newkey] = handle;
+
+  return handle;
+}
+
+
+//! Returns the cached value of a key, reading it if needed, or NULL if it does not exist.
+const Configurator::CachedValue *
+Configurator::get_cached_value(ConfigKeyHandle key, VariantType type) const
+{
+  if (key < 0 || key >= int(key_cache.size()))
+    {
+      return NULL;
+    }
+
+  CachedValue &cached = key_cache[key];
+  if (cached.generation != cache_generation || cached.type != type)
+    {
+      cached.found = get_value(cached.key, type, cached.value);
+      cached.type = type;
+      cached.generation = cache_generation;
+    }
+
+  return cached.found ? &cached : NULL;
+}
+
+
+bool
+Configurator::get_value(ConfigKeyHandle key, std::string &out) const
+{
+  const CachedValue *cached = get_cached_value(key, VARIANT_TYPE_STRING);
+  if (cached != NULL)
+    {
+      out = cached->value.string_value;
+    }
+  return cached != NULL;
+}
+
+
+bool
+Configurator::get_value(ConfigKeyHandle key, bool &out) const
+{
+  const CachedValue *cached = get_cached_value(key, VARIANT_TYPE_BOOL);
+  if (cached != NULL)
+    {
+      out = cached->value.bool_value;
+    }
+  return cached != NULL;
+}
+
+
+bool
+Configurator::get_value(ConfigKeyHandle key, int &out) const
+{
+  const CachedValue *cached = get_cached_value(key, VARIANT_TYPE_INT);
+  if (cached != NULL)
+    {
+      out = cached->value.int_value;
+    }
+  return cached != NULL;
+}
+
+
+bool
+Configurator::get_value(ConfigKeyHandle key, double &out) const
+{
+  const CachedValue *cached = get_cached_value(key, VARIANT_TYPE_DOUBLE);
+  if (cached != NULL)
+    {
+      out = cached->value.double_value;
+    }
+  return cached != NULL;
+}
+
+
+//! Discards the cached value of the specified key.
+void
+Configurator::invalidate_cache(const std::string &key) const
+{
+  string newkey = key;
+  strip_trailing_slash(newkey);
+  strip_leading_slash(newkey);
+
+  KeyHandles::const_iterator it = key_handles.find(newkey);
+  if (it != key_handles.end())
+    {
+      key_cache[it->second].generation = 0;
+    }
+}
+
+
+//! Discards all cached values.
+void
+Configurator::invalidate_cache() const
+{
+  cache_generation++;
+  if (cache_generation == 0)
+    {
+      cache_generation = 1;
+    }
+}
+
+
 bool
 Configurator::set_value(const std::string &key, const std::string &v, ConfigFlags flags)
 {
@@ -572,6 +766,101 @@ Configurator::set_typed_value(const std::string &key, const std::string &t)
 }
 
 
+//! Starts a transaction.
+bool
+Configurator::begin_transaction()
+{
+  TRACE_ENTER("Configurator::begin_transaction");
+  bool ret = !in_transaction;
+  if (ret)
+    {
+      in_transaction = true;
+      transaction_values.clear();
+    }
+  TRACE_RETURN(ret);
+  return ret;
+}
+
+
+//! Sets all values of the transaction.
+/*!
+ *  Values are set immediately, ignoring configured delays. Listeners are
+ *  notified once with all changed keys and the configuration is saved
+ *  once afterwards.
+ */
+bool
+Configurator::commit_transaction()
+{
+  TRACE_ENTER("Configurator::commit_transaction");
+  if (!in_transaction)
+    {
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  TransactionValues values;
+  values.swap(transaction_values);
+  in_transaction = false;
+
+  bool ret = true;
+
+  begin_batch();
+  for (TransactionValues::iterator i = values.begin(); i != values.end(); i++)
+    {
+      TransactionValue &t = i->second;
+      ret = set_value(t.key, t.value, ConfigFlags(t.flags | CONFIG_FLAG_IMMEDIATE)) && ret;
+    }
+  end_batch();
+
+  if (auto_save_time != 0)
+    {
+      ret = save() && ret;
+      auto_save_time = 0;
+    }
+
+  TRACE_RETURN(ret);
+  return ret;
+}
+
+
+//! Discards the transaction.
+void
+Configurator::rollback_transaction()
+{
+  TRACE_ENTER("Configurator::rollback_transaction");
+  in_transaction = false;
+  transaction_values.clear();
+  TRACE_EXIT();
+}
+
+
+//! Sets all values in a single transaction, or none if a value is invalid.
+bool
+Configurator::apply_settings(const std::map<std::string, std::string> &settings)
+{
+  TRACE_ENTER_MSG("Configurator::apply_settings", settings.size());
+  bool started = begin_transaction();
+  bool ret = started;
+
+  for (map<string, string>::const_iterator i = settings.begin(); ret && i != settings.end(); i++)
+    {
+      ret = set_typed_value(i->first, i->second);
+    }
+
+  if (ret)
+    {
+      ret = commit_transaction();
+    }
+  else if (started)
+    {
+      rollback_transaction();
+    }
+
+  TRACE_RETURN(ret);
+  return ret;
+}
+
+
 bool
 Configurator::add_listener(const std::string &key_prefix, IConfiguratorListener *listener)
 {
@@ -588,23 +877,27 @@ Configurator::add_listener(const std::string &key_prefix, IConfiguratorListener
 
   if (ret)
     {
-      ListenerIter i = listeners.begin();
-      while (ret && i != listeners.end())
+      int node = find_listener_node(key, true);
+      list<int> &serials = listener_trie[node].serials;
+
+      for (list<int>::iterator i = serials.begin(); ret && i != serials.end(); i++)
         {
-          if (key == i->first && listener == i->second)
+          if (listeners[*i].listener == listener)
             {
               // Already added. Skip
               ret = false;
             }
-
-          i++;
         }
-    }
 
-  if (ret)
-    {
-      // not found -> add
-      listeners.push_back(make_pair(key, listener));
+      if (ret)
+        {
+          // not found -> add
+          int serial = next_listener_serial++;
+          Listener &l = listeners[serial];
+          l.prefix = key;
+          l.listener = listener;
+          serials.push_back(serial);
+        }
     }
 
   return ret;
@@ -619,10 +912,15 @@ Configurator::remove_listener(IConfiguratorListener *listener)
   ListenerIter i = listeners.begin();
   while (i != listeners.end())
     {
-      if (listener == i->second)
+      if (listener == i->second.listener)
         {
           // Found. Remove
-          i = listeners.erase(i);
+          int node = find_listener_node(i->second.prefix, false);
+          if (node != -1)
+            {
+              listener_trie[node].serials.remove(i->first);
+            }
+          listeners.erase(i++);
           ret = true;
         }
       else
@@ -639,24 +937,34 @@ bool
 Configurator::remove_listener(const std::string &key_prefix, IConfiguratorListener *listener)
 {
   bool ret = false;
+  string key = key_prefix;
+
+  strip_leading_slash(key);
+  strip_trailing_slash(key);
 
   if (dynamic_cast<IConfigBackendMonitoring *>(backend) != NULL)
     {
       dynamic_cast<IConfigBackendMonitoring *>(backend)->remove_listener(key_prefix);
     }
 
-  ListenerIter i = listeners.begin();
-  while (i != listeners.end())
+  int node = find_listener_node(key, false);
+  if (node != -1)
     {
-      if (i->first == key_prefix && i->second == listener)
+      list<int> &serials = listener_trie[node].serials;
+      list<int>::iterator i = serials.begin();
+      while (i != serials.end())
         {
-          // Found. Remove
-          i = listeners.erase(i);
-          ret = true;
-        }
-      else
-        {
-          i++;
+          if (listeners[*i].listener == listener)
+            {
+              // Found. Remove
+              listeners.erase(*i);
+              i = serials.erase(i);
+              ret = true;
+            }
+          else
+            {
+              i++;
+            }
         }
     }
 
@@ -672,9 +980,9 @@ Configurator::find_listener(IConfiguratorListener *listener, std::string &key) c
   ListenerCIter i = listeners.begin();
   while (i != listeners.end())
     {
-      if (listener == i->second)
+      if (listener == i->second.listener)
         {
-          key = i->first;
+          key = i->second.prefix;
           ret = true;
           break;
         }
@@ -684,6 +992,85 @@ Configurator::find_listener(IConfiguratorListener *listener, std::string &key) c
   return ret;
 }
 
+
+//! Starts a batch of changes.
+void
+Configurator::begin_batch()
+{
+  batch_depth++;
+}
+
+
+//! Ends a batch of changes and notifies the listeners if it was the outermost batch.
+void
+Configurator::end_batch()
+{
+  if (batch_depth > 0 && --batch_depth == 0 && !batch_keys.empty())
+    {
+      set<string> keys;
+      keys.swap(batch_keys);
+      fire_configurator_batch_event(keys);
+    }
+}
+
+
+//! Returns the trie node of the specified prefix, or -1 if it does not exist and create is false.
+int
+Configurator::find_listener_node(const std::string &prefix, bool create)
+{
+  int node = 0;
+
+  for (string::size_type pos = 0; pos < prefix.length(); pos++)
+    {
+      map<char, int>::const_iterator it = listener_trie[node].children.find(prefix[pos]);
+      if (it != listener_trie[node].children.end())
+        {
+          node = it->second;
+        }
+      else if (create)
+        {
+          int child = listener_trie.size();
+          listener_trie.push_back(ListenerNode());
+          listener_trie[node].children[prefix[pos]] = child;
+          node = child;
+        }
+      else
+        {
+          return -1;
+        }
+    }
+
+  return node;
+}
+
+
+//! Collects the serials of all listeners whose prefix matches the key.
+void
+Configurator::match_listeners(const std::string &key, std::set<int> &serials) const
+{
+  int node = 0;
+  string::size_type pos = 0;
+
+  while (true)
+    {
+      const ListenerNode &n = listener_trie[node];
+      serials.insert(n.serials.begin(), n.serials.end());
+
+      if (pos == key.length())
+        {
+          break;
+        }
+
+      map<char, int>::const_iterator it = n.children.find(key[pos++]);
+      if (it == n.children.end())
+        {
+          break;
+        }
+      node = it->second;
+    }
+}
+
+
 //! Fire a configuration changed event.
 void
 Configurator::fire_configurator_event(const string &key)
@@ -694,20 +1081,67 @@ Configurator::fire_configurator_event(const string &key)
   strip_leading_slash(k);
   strip_trailing_slash(k);
 
-  ListenerIter i = listeners.begin();
-  while (i != listeners.end())
+  if (batch_depth > 0)
+    {
+      batch_keys.insert(k);
+      TRACE_EXIT();
+      return;
+    }
+
+  set<int> serials;
+  match_listeners(k, serials);
+
+  for (set<int>::iterator i = serials.begin(); i != serials.end(); i++)
     {
-      string prefix = i->first;
+      // The listener may have been removed by a previous listener.
+      ListenerIter it = listeners.find(*i);
+      if (it != listeners.end() && it->second.listener != NULL)
+        {
+          it->second.listener->config_changed_notify(k);
+        }
+    }
+
+  TRACE_EXIT();
+}
+
 
-      if (k.substr(0, prefix.length()) == prefix)
+//! Fire a single configuration changed event per listener for a batch of keys.
+void
+Configurator::fire_configurator_batch_event(const set<string> &keys)
+{
+  TRACE_ENTER_MSG("Configurator::fire_configurator_batch_event", keys.size());
+
+  typedef map<IConfiguratorListener *, set<string> > ListenerKeys;
+  ListenerKeys listener_keys;
+  map<int, IConfiguratorListener *> order;
+
+  for (set<string>::const_iterator k = keys.begin(); k != keys.end(); k++)
+    {
+      set<int> serials;
+      match_listeners(*k, serials);
+
+      for (set<int>::iterator i = serials.begin(); i != serials.end(); i++)
         {
-          IConfiguratorListener *l = i->second;
+          IConfiguratorListener *l = listeners[*i].listener;
           if (l != NULL)
             {
-              l->config_changed_notify(k);
+              if (listener_keys.find(l) == listener_keys.end())
+                {
+                  order[*i] = l;
+                }
+              listener_keys[l].insert(*k);
             }
         }
-      i++;
+    }
+
+  for (map<int, IConfiguratorListener *>::iterator i = order.begin(); i != order.end(); i++)
+    {
+      // The listener may have been removed by a previous listener.
+      string prefix;
+      if (find_listener(i->second, prefix))
+        {
+          i->second->config_batch_changed_notify(listener_keys[i->second]);
+        }
     }
 
   TRACE_EXIT();
@@ -774,9 +1208,23 @@ Configurator::find_setting(const string &key, Setting &setting) const
   return ret;
 }
 
+//! Notification from a monitoring backend that a key or a directory of keys changed.
 void
 Configurator::config_changed_notify(const std::string &key)
 {
+  string newkey = key;
+  strip_trailing_slash(newkey);
+  strip_leading_slash(newkey);
+
+  if (key_handles.find(newkey) != key_handles.end())
+    {
+      invalidate_cache(newkey);
+    }
+  else
+    {
+      invalidate_cache();
+    }
+
   fire_configurator_event(key);
 }
 
@@ -25,6 +25,8 @@
 #include <string>
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
 
 #include "Mutex.hh"
 #include "IConfigurator.hh"
@@ -49,6 +51,7 @@ public:
   virtual ~Configurator();
 
   void heartbeat();
+  time_t get_next_deadline() const;
 
   // IConfigurator
   virtual void set_delay(const std::string &name, int delay);
@@ -65,6 +68,12 @@ public:
   virtual bool get_value(const std::string &key, int &out) const;
   virtual bool get_value(const std::string &key, double &out) const;
 
+  virtual ConfigKeyHandle resolve_key(const std::string &key);
+  virtual bool get_value(ConfigKeyHandle key, std::string &out) const;
+  virtual bool get_value(ConfigKeyHandle key, bool &out) const;
+  virtual bool get_value(ConfigKeyHandle key, int &out) const;
+  virtual bool get_value(ConfigKeyHandle key, double &out) const;
+
   virtual void get_value_with_default(const std::string & key, std::string &out, string s) const;
   virtual void get_value_with_default(const std::string & key, bool &out, const bool def) const;
   virtual void get_value_with_default(const std::string & key, int &out, const int def) const;
@@ -84,14 +93,57 @@ public:
   virtual bool remove_listener(const std::string &key_prefix, IConfiguratorListener *listener);
   virtual bool find_listener(IConfiguratorListener *listener, std::string &key) const;
 
+  virtual void begin_batch();
+  virtual void end_batch();
+
+  virtual bool begin_transaction();
+  virtual bool commit_transaction();
+  virtual void rollback_transaction();
+  virtual bool apply_settings(const std::map<std::string, std::string> &settings);
+
 private:
-  typedef std::list<std::pair<std::string, IConfiguratorListener *> > Listeners;
-  typedef std::list<std::pair<std::string, IConfiguratorListener *> >::iterator ListenerIter;
-  typedef std::list<std::pair<std::string, IConfiguratorListener *> >::const_iterator ListenerCIter;
+  //! A registered listener.
+  struct Listener
+  {
+    //! Key prefix without leading and trailing slashes.
+    std::string prefix;
+
+    //! The listener.
+    IConfiguratorListener *listener;
+  };
+
+  //! Registered listeners, indexed by registration serial.
+  typedef std::map<int, Listener> Listeners;
+  typedef Listeners::iterator ListenerIter;
+  typedef Listeners::const_iterator ListenerCIter;
+
+  //! Node of the listener prefix trie.
+  struct ListenerNode
+  {
+    //! Child nodes, indexed by the next character of the prefix.
+    std::map<char, int> children;
+
+    //! Serials of the listeners registered with the prefix of this node.
+    std::list<int> serials;
+  };
+
+  typedef std::vector<ListenerNode> ListenerTrie;
 
   //! Configuration change listeners.
   Listeners listeners;
 
+  //! Prefix trie of the listeners. Node 0 is the empty prefix.
+  ListenerTrie listener_trie;
+
+  //! Serial of the next listener registration.
+  int next_listener_serial;
+
+  //! Nesting depth of batches.
+  int batch_depth;
+
+  //! Keys changed during the current batch.
+  std::set<std::string> batch_keys;
+
 private:
   struct DelayedConfig
   {
@@ -110,18 +162,74 @@ private:
   typedef DelayedList::iterator DelayedListIter;
   typedef DelayedList::const_iterator DelayedListCIter;
 
+  //! Deadline of a delayed setting.
+  struct DelayedDeadline
+  {
+    time_t until;
+    std::string key;
+  };
+
+  //! Orders the deadline heap so that the earliest deadline is on top.
+  struct DelayedDeadlineLater
+  {
+    bool operator()(const DelayedDeadline &a, const DelayedDeadline &b) const
+    {
+      return a.until > b.until;
+    }
+  };
+
+  typedef std::vector<DelayedDeadline> DelayedDeadlines;
+
+  //! A value set during a transaction.
+  struct TransactionValue
+  {
+    std::string key;
+    Variant value;
+    ConfigFlags flags;
+  };
+
+  typedef std::map<std::string, TransactionValue> TransactionValues;
+
   typedef std::map<std::string, Setting> Settings;
   typedef std::map<std::string, Setting>::iterator SettingIter;
   typedef std::map<std::string, Setting>::const_iterator SettingCIter;
 
+  //! Cached value of a resolved key.
+  struct CachedValue
+  {
+    //! Key without leading and trailing slashes.
+    std::string key;
+
+    //! The value is valid if this equals the cache generation.
+    unsigned int generation;
+
+    //! Type with which the value was read.
+    VariantType type;
+
+    //! Whether the key exists with this type.
+    bool found;
+
+    //! The value.
+    Variant value;
+  };
+
+  typedef std::vector<CachedValue> KeyCache;
+  typedef std::map<std::string, ConfigKeyHandle> KeyHandles;
+
 
 private:
   bool find_setting(const string &name, Setting &setting) const;
 
   bool set_value(const std::string &key, Variant &value, ConfigFlags flags = CONFIG_FLAG_NONE);
   bool get_value(const std::string &key, VariantType type, Variant &value) const;
+  const CachedValue *get_cached_value(ConfigKeyHandle key, VariantType type) const;
+  void invalidate_cache(const std::string &key) const;
+  void invalidate_cache() const;
 
+  int find_listener_node(const std::string &prefix, bool create);
+  void match_listeners(const std::string &key, std::set<int> &serials) const;
   void fire_configurator_event(const std::string &key);
+  void fire_configurator_batch_event(const std::set<std::string> &keys);
   void strip_leading_slash(std::string &key) const;
   void strip_trailing_slash(std::string &key) const;
   void add_trailing_slash(std::string &key) const;
@@ -135,6 +243,28 @@ private:
   //! Delayed settings
   DelayedList delayed_config;
 
+  //! Min-heap of the deadlines of the delayed settings.
+  /*!
+   *  A deadline is stale if the setting was changed again before its
+   *  deadline; stale deadlines are discarded when they reach the top.
+   */
+  DelayedDeadlines delayed_deadlines;
+
+  //! Is a transaction active?
+  bool in_transaction;
+
+  //! Values set in the active transaction, indexed by key.
+  TransactionValues transaction_values;
+
+  //! Cached values, indexed by key handle.
+  mutable KeyCache key_cache;
+
+  //! Key handles, indexed by key.
+  KeyHandles key_handles;
+
+  //! Current generation of the cache. Incremented to invalidate all values.
+  mutable unsigned int cache_generation;
+
   //! The backend in use.
   IConfigBackend *backend;
 
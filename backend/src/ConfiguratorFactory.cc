@@ -28,11 +28,12 @@
 
 #ifdef HAVE_GLIB
 #include "GlibIniConfigurator.hh"
+#include "GlibXmlConfigurator.hh"
 #endif
 #ifdef HAVE_GSETTINGS
 #include "GSettingsConfigurator.hh"
 #endif
-#ifdef HAVE_GDOME
+#if defined(HAVE_GDOME) && !defined(HAVE_GLIB)
 #include "XMLConfigurator.hh"
 #endif
 #ifdef HAVE_GCONF
@@ -52,7 +53,13 @@ ConfiguratorFactory::create(Format fmt)
   Configurator *c =  NULL;
   IConfigBackend *b = NULL;
 
-#ifdef HAVE_GDOME
+#if defined(HAVE_GLIB)
+  if (fmt == FormatXml)
+    {
+      b = new GlibXmlConfigurator();
+    }
+  else
+#elif defined(HAVE_GDOME)
   if (fmt == FormatXml)
     {
       b = new XMLConfigurator();
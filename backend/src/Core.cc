@@ -32,6 +32,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "Core.hh"
 
@@ -45,6 +46,7 @@
 #include "Configurator.hh"
 #include "CoreConfig.hh"
 #include "Statistics.hh"
+#include "PersistenceManager.hh"
 #include "BreakControl.hh"
 #include "Timer.hh"
 #include "TimePredFactory.hh"
@@ -88,11 +90,16 @@ const int SAVESTATETIME = 60;
 //! Constructs a new Core.
 Core::Core() :
   last_process_time(0),
+  next_heartbeat_time(0),
+  heartbeat_period_start(0),
+  heartbeat_count(0),
+  heartbeats_per_hour(0),
   master_node(true),
   configurator(NULL),
   monitor(NULL),
   application(NULL),
   statistics(NULL),
+  persistence_manager(NULL),
   operation_mode(OPERATION_MODE_NORMAL),
   operation_mode_regular(OPERATION_MODE_NORMAL),
   usage_mode(USAGE_MODE_NORMAL),
@@ -154,6 +161,12 @@ Core::~Core()
 #endif
 #endif
 
+  if (persistence_manager != NULL)
+    {
+      persistence_manager->terminate();
+      delete persistence_manager;
+    }
+
   TRACE_EXIT();
 }
 
@@ -171,6 +184,9 @@ Core::init(int argc, char **argv, IApp *app, const string &display_name)
   this->argc = argc;
   this->argv = argv;
 
+  persistence_manager = new PersistenceManager();
+  persistence_manager->init();
+
   init_configurator();
   init_monitor(display_name);
 
@@ -261,6 +277,17 @@ Core::init_bus()
 #ifdef HAVE_TESTS
       dbus->connect("/org/workrave/Workrave/Debug", "org.workrave.DebugInterface", Test::get_instance());
       dbus->register_object_path("/org/workrave/Workrave/Debug");
+
+      // Lets a test script address each of several instances.
+      const char *name = getenv("WORKRAVE_DBUS_NAME");
+      if (name != NULL)
+        {
+#ifdef HAVE_DBUS_GIO
+          dbus->register_service(name, NULL);
+#else
+          dbus->register_service(name);
+#endif
+        }
 #endif
     }
   catch (DBusException &)
@@ -290,6 +317,7 @@ Core::init_monitor(const string &display_name)
   configurator->set_value(CoreConfig::CFG_KEY_MONITOR_SENSITIVITY, 3, CONFIG_FLAG_DEFAULT);
 
   monitor = new ActivityMonitor();
+  monitor->set_wakeup_listener(this);
   load_monitor_config();
 
   configurator->add_listener(CoreConfig::CFG_KEY_MONITOR, this);
@@ -320,12 +348,12 @@ Core::init_distribution_manager()
   dist_manager->register_client_message(DCM_BREAKS, DCMT_MASTER, this);
   dist_manager->register_client_message(DCM_TIMERS, DCMT_MASTER, this);
   dist_manager->register_client_message(DCM_MONITOR, DCMT_MASTER, this);
-  dist_manager->register_client_message(DCM_IDLELOG, DCMT_SIGNON, this);
+  dist_manager->register_client_message(DCM_IDLELOG, DCMT_PASSIVE, this);
   dist_manager->register_client_message(DCM_BREAKCONTROL, DCMT_PASSIVE, this);
 
   dist_manager->add_listener(this);
 
-  idlelog_manager = new IdleLogManager(dist_manager->get_my_id(), this);
+  idlelog_manager = new IdleLogManager(dist_manager->get_my_id(), this, persistence_manager);
   idlelog_manager->init();
 }
 #endif
@@ -511,6 +539,14 @@ Core::get_statistics() const
 }
 
 
+//! Returns the background file writer.
+PersistenceManager *
+Core::get_persistence_manager() const
+{
+  return persistence_manager;
+}
+
+
 //! Returns the specified break controller.
 Break *
 Core::get_break(BreakId id)
@@ -557,6 +593,21 @@ Core::get_distribution_manager() const
 #endif
 
 
+//! Returns the traffic and handling time per distribution packet and client message.
+void
+Core::get_distribution_metrics(DistributionMessageMetricsList &metrics) const
+{
+#ifdef HAVE_DISTRIBUTION
+  if (dist_manager != NULL)
+    {
+      dist_manager->get_message_metrics(metrics);
+    }
+#else
+  (void) metrics;
+#endif
+}
+
+
 //! Retrieves the operation mode.
 OperationMode
 Core::get_operation_mode()
@@ -1115,6 +1166,10 @@ Core::heartbeat()
   // Set current time.
   current_time = time(NULL);
 
+  // Process queued input events.
+  monitor->process_events();
+  statistics->process_events();
+
   // Performs timewarp checking.
   bool warped = process_timewarp();
 
@@ -1143,20 +1198,115 @@ Core::heartbeat()
         }
     }
 
-  // Make state persistent.
-  if (current_time % SAVESTATETIME == 0)
+  // Make state persistent. Heartbeats may be skipped, so check whether
+  // a SAVESTATETIME boundary was passed since the previous heartbeat.
+  if (last_process_time != 0 &&
+      current_time / SAVESTATETIME != last_process_time / SAVESTATETIME)
     {
       statistics->update();
       save_state();
     }
 
+  process_heartbeat_statistics();
+
   // Done.
   last_process_time = current_time;
+  next_heartbeat_time = compute_next_heartbeat_time();
 
   TRACE_EXIT();
 }
 
 
+//! Keeps track of the number of heartbeats per hour.
+void
+Core::process_heartbeat_statistics()
+{
+  TRACE_ENTER("Core::process_heartbeat_statistics");
+  if (heartbeat_period_start == 0)
+    {
+      heartbeat_period_start = current_time;
+    }
+  else if (current_time >= heartbeat_period_start + 3600 ||
+           current_time < heartbeat_period_start)
+    {
+      TRACE_MSG("Heartbeats in last hour: " << heartbeat_count);
+      heartbeats_per_hour = heartbeat_count;
+      heartbeat_count = 0;
+      heartbeat_period_start = current_time;
+    }
+
+  heartbeat_count++;
+  TRACE_EXIT();
+}
+
+
+//! Computes the time of the next heartbeat that has any effect.
+/*!
+ *  While the user is idle, nothing changes until the next timer reset,
+ *  predicate reset, state save or delayed configuration commit. Return 0
+ *  if a heartbeat is needed every second.
+ */
+time_t
+Core::compute_next_heartbeat_time()
+{
+  if (local_state == ACTIVITY_ACTIVE || monitor_state == ACTIVITY_ACTIVE ||
+      local_state == ACTIVITY_SUSPENDED || !external_activity.empty() || powersave)
+    {
+      return 0;
+    }
+
+#ifdef HAVE_DISTRIBUTION
+  if (dist_manager != NULL && dist_manager->get_enabled())
+    {
+      // Peers send state at any time and the link needs regular processing.
+      return 0;
+    }
+#endif
+
+  time_t next = (current_time / SAVESTATETIME + 1) * SAVESTATETIME;
+
+  for (int i = 0; i < BREAK_ID_SIZEOF; i++)
+    {
+      BreakControl *bc = breaks[i].get_break_control();
+      if (bc != NULL && bc->need_heartbeat())
+        {
+          return 0;
+        }
+
+      Timer *timer = breaks[i].get_timer();
+      if (timer->get_state() == STATE_RUNNING)
+        {
+          return 0;
+        }
+
+      time_t times[] = { timer->get_next_limit_time(),
+                         timer->get_next_reset_time(),
+                         timer->get_next_pred_reset_time() };
+
+      for (size_t j = 0; j < sizeof(times) / sizeof(times[0]); j++)
+        {
+          if (times[j] != 0 && times[j] < next)
+            {
+              next = times[j];
+            }
+        }
+    }
+
+  time_t config_time = configurator->get_next_deadline();
+  if (config_time != 0 && config_time < next)
+    {
+      next = config_time;
+    }
+
+  if (next <= current_time + 1)
+    {
+      next = 0;
+    }
+
+  return next;
+}
+
+
 //! Performs all distribution processing.
 void
 Core::process_distribution()
@@ -1181,6 +1331,9 @@ Core::process_distribution()
         {
           master_node = dist_manager->claim();
         }
+
+      statistics->sync_history();
+      sync_idlelogs();
     }
 
   if ( (previous_master_mode != master_node) ||
@@ -1382,6 +1535,23 @@ Core::process_timers()
   TRACE_EXIT();
 }
 
+//! Returns the time at which the current heartbeat was expected.
+time_t
+Core::get_expected_heartbeat_time() const
+{
+  time_t expected = last_process_time + 1;
+
+  if (next_heartbeat_time > expected)
+    {
+      // The GUI was allowed to skip heartbeats until next_heartbeat_time,
+      // or until it was woken up by activity.
+      expected = std::min(current_time, next_heartbeat_time);
+    }
+
+  return expected;
+}
+
+
 #if defined(PLATFORM_OS_WIN32)
 
 //! Process a possible timewarp on Win32
@@ -1393,7 +1563,7 @@ Core::process_timewarp()
   TRACE_ENTER("Core::process_timewarp");
   if (last_process_time != 0)
     {
-      time_t gap = current_time - 1 - last_process_time;
+      time_t gap = current_time - get_expected_heartbeat_time();
   
       if (abs((int)gap) > 5)
         {
@@ -1447,7 +1617,7 @@ Core::process_timewarp()
   TRACE_ENTER("Core::process_timewarp");
   if (last_process_time != 0)
     {
-      int gap = current_time - 1 - last_process_time;
+      int gap = current_time - get_expected_heartbeat_time();
 
       if (gap >= 30)
         {
@@ -1669,11 +1839,7 @@ Core::daily_reset()
 void
 Core::save_state() const
 {
-  stringstream ss;
-  ss << Util::get_home_directory();
-  ss << "state" << ends;
-
-  ofstream stateFile(ss.str().c_str());
+  stringstream stateFile;
 
   stateFile << "WorkRaveState 3"  << endl
             << get_time() << endl;
@@ -1685,7 +1851,7 @@ Core::save_state() const
       stateFile << stateStr << endl;
     }
 
-  stateFile.close();
+  persistence_manager->write_file(Util::get_home_directory() + "state", stateFile.str());
 }
 
 
@@ -1777,6 +1943,21 @@ Core::post_event(CoreEvent event)
 }
 
 
+//! Activity after being idle is reported by the activity monitor.
+/*!
+ *  This is called from the thread of the input monitor.
+ */
+bool
+Core::action_notify()
+{
+  if (core_event_listener != NULL)
+    {
+      core_event_listener->core_event_wakeup();
+    }
+  return true;
+}
+
+
 //! Excecute the insist policy.
 void
 Core::freeze()
@@ -1885,11 +2066,6 @@ Core::request_client_message(DistributionClientMessageID id, PacketBuffer &buffe
       ret = true;
       break;
 
-    case DCM_IDLELOG:
-      idlelog_manager->get_idlelog(buffer);
-      ret = true;
-      break;
-
     default:
       break;
     }
@@ -2161,15 +2337,41 @@ Core::signoff_remote_client(string client_id)
 }
 
 
+//! Sends my idle log to the clients that need it.
+/*!
+ *  Each client only receives the intervals that it did not confirm.
+ */
+void
+Core::sync_idlelogs()
+{
+  list<string> client_ids;
+  idlelog_manager->get_idlelog_receivers(client_ids);
+
+  for (list<string>::iterator i = client_ids.begin(); i != client_ids.end(); i++)
+    {
+      PacketBuffer buffer;
+      buffer.create();
+
+      idlelog_manager->get_idlelog(buffer, *i);
+      if (dist_manager->unicast_client_message(DCM_IDLELOG, *i, buffer))
+        {
+          idlelog_manager->idlelog_sent(*i);
+        }
+    }
+}
+
+
 void
 Core::compute_timers()
 {
   TRACE_ENTER("IdleLogManager:compute_timers");
 
+  int common_idle = idlelog_manager->compute_idle_time();
+
   for (int i = 0; i < BREAK_ID_SIZEOF; i++)
     {
       int autoreset = breaks[i].get_timer()->get_auto_reset();
-      int idle = idlelog_manager->compute_idle_time();
+      int idle = common_idle;
 
       if (autoreset != 0)
         {
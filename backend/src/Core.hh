@@ -46,12 +46,14 @@
 #include "Break.hh"
 #include "IBreakResponse.hh"
 #include "IActivityMonitor.hh"
+#include "ActivityMonitorListener.hh"
 #include "ICore.hh"
 #include "ICoreEventListener.hh"
 #include "IConfiguratorListener.hh"
 #include "TimeSource.hh"
 #include "Timer.hh"
 #include "Statistics.hh"
+#include "DistributionMetrics.hh"
 
 using namespace workrave;
 
@@ -66,6 +68,7 @@ namespace workrave {
 class ActivityMonitor;
 class Configurator;
 class Statistics;
+class PersistenceManager;
 class FakeActivityMonitor;
 class IdleLogManager;
 class BreakControl;
@@ -84,7 +87,8 @@ class Core :
   public TimeSource,
   public ICore,
   public IConfiguratorListener,
-  public IBreakResponse
+  public IBreakResponse,
+  public ActivityMonitorListener
 {
 public:
   Core();
@@ -105,12 +109,16 @@ public:
   DistributionManager *get_distribution_manager() const;
 #endif
   Statistics *get_statistics() const;
+  PersistenceManager *get_persistence_manager() const;
   void set_core_events_listener(ICoreEventListener *l);
   void force_break(BreakId id, BreakHint break_hint);
   void time_changed();
   void set_powersave(bool down);
 
   time_t get_time() const;
+  time_t get_next_heartbeat_time() const;
+  int get_heartbeats_per_hour() const;
+  void get_distribution_metrics(DistributionMessageMetricsList &metrics) const;
   void post_event(CoreEvent event);
 
   OperationMode get_operation_mode();
@@ -149,6 +157,9 @@ public:
   void postpone_break(BreakId break_id);
   void skip_break(BreakId break_id);
 
+  // ActivityMonitorListener
+  bool action_notify();
+
 #ifdef HAVE_DBUS
   DBus *get_dbus()
   {
@@ -176,10 +187,13 @@ private:
   void load_monitor_config();
   void config_changed_notify(const std::string &key);
   void heartbeat();
+  void process_heartbeat_statistics();
+  time_t compute_next_heartbeat_time();
   void timer_action(BreakId id, TimerInfo info);
   void process_distribution();
   void process_state();
   bool process_timewarp();
+  time_t get_expected_heartbeat_time() const;
   void process_timers();
   void start_break(BreakId break_id, BreakId resume_this_break = BREAK_ID_NONE);
   void stop_all_breaks();
@@ -225,6 +239,7 @@ private:
 
   void signon_remote_client(string client_id);
   void signoff_remote_client(string client_id);
+  void sync_idlelogs();
   void compute_timers();
 #endif // HAVE_DISTRIBUTION
 
@@ -245,6 +260,18 @@ private:
   //! The time we last processed the timers.
   time_t last_process_time;
 
+  //! The time of the next heartbeat that has any effect, 0 if every second.
+  time_t next_heartbeat_time;
+
+  //! Start of the current heartbeat statistics period.
+  time_t heartbeat_period_start;
+
+  //! Number of heartbeats in the current period.
+  int heartbeat_count;
+
+  //! Number of heartbeats in the previous period.
+  int heartbeats_per_hour;
+
   //! Are we the master node??
   bool master_node;
 
@@ -263,6 +290,9 @@ private:
   //! The statistics collector.
   Statistics *statistics;
 
+  //! Writes the state files in the background.
+  PersistenceManager *persistence_manager;
+
   //! Current operation mode.
   OperationMode operation_mode;
 
@@ -355,4 +385,18 @@ Core::is_master() const
   return master_node;
 }
 
+//! Returns the time of the next heartbeat that has any effect.
+inline time_t
+Core::get_next_heartbeat_time() const
+{
+  return next_heartbeat_time;
+}
+
+//! Returns the number of heartbeats during the last hour.
+inline int
+Core::get_heartbeats_per_hour() const
+{
+  return heartbeats_per_hour;
+}
+
 #endif // CORE_HH
@@ -21,12 +21,14 @@
 #define DISTRIBUTIONLINK_HH
 
 #include <string>
+#include <map>
 
 class DistributionLinkListener;
 class IDistributionClientMessage;
 class PacketBuffer;
 
 #include "IDistributionClientMessage.hh"
+#include "DistributionMetrics.hh"
 
 class DistributionLink
 {
@@ -39,6 +41,16 @@ public:
   //! Returns the number of remote peers.
   virtual int get_number_of_peers() = 0;
 
+  //! Returns the number of bytes waiting to be sent to each remote peer.
+  virtual std::map<std::string, int> get_peer_queue_sizes() = 0;
+
+  //! Returns the number of packets and bytes sent and received.
+  virtual void get_packet_counts(int &packets_sent, int &packets_received,
+                                 int &bytes_sent, int &bytes_received) = 0;
+
+  //! Returns the traffic and handling time per packet and client message.
+  virtual void get_message_metrics(DistributionMessageMetricsList &metrics) = 0;
+
   //! Sets the callback interface to the distribution manager.
   // virtual void set_distribution_manager(DistributionLinkListener *dll) = 0;
 
@@ -77,6 +89,10 @@ public:
   virtual bool broadcast_client_message(DistributionClientMessageID id,
                                         PacketBuffer &buffer) = 0;
 
+  //! Sends a client message to the specified remote host.
+  virtual bool unicast_client_message(DistributionClientMessageID id, const std::string &client_id,
+                                      PacketBuffer &buffer) = 0;
+
   //! Disconnects from all remote clients.
   virtual bool disconnect_all() = 0;
 
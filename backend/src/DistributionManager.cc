@@ -116,6 +116,49 @@ DistributionManager::get_number_of_peers()
 }
 
 
+//! Returns the number of bytes waiting to be sent to each peer.
+map<string, int>
+DistributionManager::get_peer_queue_sizes()
+{
+  map<string, int> ret;
+
+  if (link != NULL)
+    {
+      ret = link->get_peer_queue_sizes();
+    }
+
+  return ret;
+}
+
+
+//! Returns the number of packets and bytes sent and received.
+void
+DistributionManager::get_packet_counts(int &packets_sent, int &packets_received,
+                                       int &bytes_sent, int &bytes_received)
+{
+  packets_sent = 0;
+  packets_received = 0;
+  bytes_sent = 0;
+  bytes_received = 0;
+
+  if (link != NULL)
+    {
+      link->get_packet_counts(packets_sent, packets_received, bytes_sent, bytes_received);
+    }
+}
+
+
+//! Returns the traffic and handling time per packet and client message.
+void
+DistributionManager::get_message_metrics(DistributionMessageMetricsList &metrics)
+{
+  if (link != NULL)
+    {
+      link->get_message_metrics(metrics);
+    }
+}
+
+
 //! Returns true if this node is master.
 bool
 DistributionManager::is_master() const
@@ -353,6 +396,21 @@ DistributionManager::broadcast_client_message(DistributionClientMessageID id, Pa
 }
 
 
+//! Sends a client message to the specified client.
+bool
+DistributionManager::unicast_client_message(DistributionClientMessageID id, const string &client_id,
+                                            PacketBuffer &buffer)
+{
+  bool ret = false;
+
+  if (link != NULL)
+    {
+      ret = link->unicast_client_message(id, client_id, buffer);
+    }
+  return ret;
+}
+
+
 //! Event from Link that our 'master' status changed.
 void
 DistributionManager::master_changed(bool new_master, string id)
@@ -791,6 +849,27 @@ DistributionManager::set_listening(bool b)
 }
 
 
+bool
+DistributionManager::get_discovery() const
+{
+  bool ret = true;
+  bool is_set = configurator->get_value(CoreConfig::CFG_KEY_DISTRIBUTION_DISCOVERY, ret);
+  if (!is_set)
+    {
+      ret = false;
+    }
+
+  return ret;
+}
+
+
+void
+DistributionManager::set_discovery(bool b)
+{
+  configurator->set_value(CoreConfig::CFG_KEY_DISTRIBUTION_DISCOVERY, b);
+}
+
+
 string
 DistributionManager::get_username() const
 {
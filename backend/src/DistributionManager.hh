@@ -22,12 +22,14 @@
 
 #include <string>
 #include <list>
+#include <map>
 
 using namespace std;
 
 #include "IConfiguratorListener.hh"
 #include "IDistributionClientMessage.hh"
 #include "IDistributionManager.hh"
+#include "DistributionMetrics.hh"
 
 using namespace workrave;
 namespace workrave
@@ -58,6 +60,10 @@ public:
   string get_master_id() const;
   string get_my_id() const;
   int get_number_of_peers();
+  map<string, int> get_peer_queue_sizes();
+  void get_message_metrics(DistributionMessageMetricsList &metrics);
+  void get_packet_counts(int &packets_sent, int &packets_received,
+                         int &bytes_sent, int &bytes_received);
   bool claim();
   bool set_lock_master(bool lock);
   bool connect(string url);
@@ -70,6 +76,7 @@ public:
   bool remove_listener(DistributionListener *listener);
 
   bool broadcast_client_message(DistributionClientMessageID id, PacketBuffer &buffer);
+  bool unicast_client_message(DistributionClientMessageID id, const string &client_id, PacketBuffer &buffer);
   bool add_peer(string peer);
   bool remove_peer(string peer);
   bool disconnect_all();
@@ -88,6 +95,9 @@ public:
   bool get_listening() const;
   void set_listening(bool b);
 
+  bool get_discovery() const;
+  void set_discovery(bool b);
+
   string get_username() const;
   void set_username(string name);
 
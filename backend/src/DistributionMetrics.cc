@@ -0,0 +1,136 @@
+// DistributionMetrics.cc --- Traffic and timing per distribution message
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_DISTRIBUTION
+
+#include "DistributionMetrics.hh"
+
+using namespace std;
+
+//! Records a packet or client message that was sent.
+void
+DistributionMetrics::sent(Kind kind, int id, const char *name, int bytes)
+{
+  DistributionMessageMetrics &entry = get_entry(kind, id, name);
+  entry.packets_out++;
+  entry.bytes_out += bytes;
+}
+
+
+//! Records a packet or client message that was received.
+void
+DistributionMetrics::received(Kind kind, int id, const char *name, int bytes, bool routed)
+{
+  DistributionMessageMetrics &entry = get_entry(kind, id, name);
+  entry.packets_in++;
+  entry.bytes_in += bytes;
+  if (routed)
+    {
+      entry.routed_in++;
+    }
+  else
+    {
+      entry.direct_in++;
+    }
+}
+
+
+//! Records the time spent handling a received packet or client message.
+void
+DistributionMetrics::handled(Kind kind, int id, gint64 usec)
+{
+  MetricsMap::iterator it = entries.find((kind << 16) | id);
+  if (it == entries.end())
+    {
+      return;
+    }
+
+  DistributionMessageMetrics &entry = it->second;
+  if (usec < 0)
+    {
+      usec = 0;
+    }
+
+  entry.handler_usec += usec;
+  if ((guint64)usec > entry.handler_max_usec)
+    {
+      entry.handler_max_usec = usec;
+    }
+
+  int bucket = 0;
+  for (gint64 limit = 10; usec >= limit && bucket < HISTOGRAM_SIZE - 1; limit *= 10)
+    {
+      bucket++;
+    }
+  entry.handler_histogram[bucket]++;
+}
+
+
+//! Returns the metrics of all packets and client messages seen so far.
+void
+DistributionMetrics::get_metrics(DistributionMessageMetricsList &metrics) const
+{
+  for (MetricsMap::const_iterator it = entries.begin(); it != entries.end(); it++)
+    {
+      metrics.push_back(it->second);
+    }
+}
+
+
+//! Returns the traffic of all packets or all client messages.
+void
+DistributionMetrics::get_totals(Kind kind, guint32 &packets_out, guint32 &packets_in,
+                                guint64 &bytes_out, guint64 &bytes_in) const
+{
+  packets_out = 0;
+  packets_in = 0;
+  bytes_out = 0;
+  bytes_in = 0;
+
+  for (MetricsMap::const_iterator it = entries.begin(); it != entries.end(); it++)
+    {
+      if ((it->first >> 16) == kind)
+        {
+          packets_out += it->second.packets_out;
+          packets_in += it->second.packets_in;
+          bytes_out += it->second.bytes_out;
+          bytes_in += it->second.bytes_in;
+        }
+    }
+}
+
+
+//! Returns the metrics of the specified packet or client message.
+DistributionMessageMetrics &
+DistributionMetrics::get_entry(Kind kind, int id, const char *name)
+{
+  DistributionMessageMetrics &entry = entries[(kind << 16) | id];
+  if (entry.handler_histogram.empty())
+    {
+      entry.name = name;
+      entry.handler_histogram.resize(HISTOGRAM_SIZE, 0);
+    }
+  return entry;
+}
+
+#endif
@@ -0,0 +1,113 @@
+// DistributionMetrics.hh --- Traffic and timing per distribution message
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef DISTRIBUTIONMETRICS_HH
+#define DISTRIBUTIONMETRICS_HH
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <glib.h>
+
+//! Number of handler calls per handling time: < 10us, < 100us, ... >= 100ms.
+typedef std::vector<guint32> DistributionHistogram;
+
+//! Traffic and handling time of a single kind of packet or client message.
+struct DistributionMessageMetrics
+{
+  DistributionMessageMetrics() :
+    packets_in(0),
+    packets_out(0),
+    bytes_in(0),
+    bytes_out(0),
+    routed_in(0),
+    direct_in(0),
+    handler_usec(0),
+    handler_max_usec(0)
+  {
+  }
+
+  //! Name of the packet ("packet.hello1") or client message ("message.timers").
+  std::string name;
+
+  //! Number of received packets or client messages.
+  guint32 packets_in;
+
+  //! Number of sent packets or client messages, counted once per connection.
+  guint32 packets_out;
+
+  //! Number of received bytes.
+  guint64 bytes_in;
+
+  //! Number of sent bytes.
+  guint64 bytes_out;
+
+  //! Number received from a client that is not directly connected.
+  guint32 routed_in;
+
+  //! Number received from a directly connected client.
+  guint32 direct_in;
+
+  //! Total time spent in the handler.
+  guint64 handler_usec;
+
+  //! Longest time spent in the handler.
+  guint64 handler_max_usec;
+
+  //! Distribution of the time spent in the handler.
+  DistributionHistogram handler_histogram;
+};
+
+typedef std::list<DistributionMessageMetrics> DistributionMessageMetricsList;
+
+
+//! Collects the metrics of all packets and client messages of a link.
+class DistributionMetrics
+{
+public:
+  enum Kind
+    {
+      KIND_PACKET = 0,
+      KIND_CLIENT_MESSAGE = 1,
+    };
+
+  //! Number of buckets in the handler time histogram.
+  static const int HISTOGRAM_SIZE = 6;
+
+  void sent(Kind kind, int id, const char *name, int bytes);
+  void received(Kind kind, int id, const char *name, int bytes, bool routed);
+  void handled(Kind kind, int id, gint64 usec);
+
+  void get_metrics(DistributionMessageMetricsList &metrics) const;
+  void get_totals(Kind kind, guint32 &packets_out, guint32 &packets_in,
+                  guint64 &bytes_out, guint64 &bytes_in) const;
+
+private:
+  typedef std::map<int, DistributionMessageMetrics> MetricsMap;
+
+  DistributionMessageMetrics &get_entry(Kind kind, int id, const char *name);
+
+private:
+  //! Metrics indexed by kind and id.
+  MetricsMap entries;
+};
+
+#endif // DISTRIBUTIONMETRICS_HH
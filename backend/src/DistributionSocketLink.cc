@@ -57,6 +57,46 @@
 
 using namespace std;
 
+//! Returns the name of a client message, for the metrics.
+static const char *
+get_client_message_name(int id)
+{
+  switch (id)
+    {
+    case DCM_TIMERS: return "message.timers";
+    case DCM_MONITOR: return "message.monitor";
+    case DCM_IDLELOG: return "message.idlelog";
+    case DCM_SCRIPT: return "message.script";
+    case DCM_CONFIG: return "message.config";
+    case DCM_BREAKS: return "message.breaks";
+    case DCM_STATS: return "message.stats";
+    case DCM_BREAKCONTROL: return "message.breakcontrol";
+    }
+  return "message.unknown";
+}
+
+
+//! Returns the name of a packet command, for the metrics.
+const char *
+DistributionSocketLink::get_command_name(int cmd)
+{
+  switch (cmd)
+    {
+    case PACKET_HELLO1: return "packet.hello1";
+    case PACKET_CLAIM: return "packet.claim";
+    case PACKET_CLIENT_LIST: return "packet.client_list";
+    case PACKET_WELCOME: return "packet.welcome";
+    case PACKET_NEW_MASTER: return "packet.new_master";
+    case PACKET_CLIENTMSG: return "packet.client_message";
+    case PACKET_DUPLICATE: return "packet.duplicate";
+    case PACKET_CLAIM_REJECT: return "packet.claim_reject";
+    case PACKET_SIGNOFF: return "packet.signoff";
+    case PACKET_HELLO2: return "packet.hello2";
+    }
+  return "packet.unknown";
+}
+
+
 //! Construct a new socket link.
 /*!
  *  \param conf Configurator to use.
@@ -71,6 +111,9 @@ DistributionSocketLink::DistributionSocketLink(Configurator *conf) :
   master_locked(false),
   server_port(DEFAULT_PORT),
   server_socket(NULL),
+  discovery_socket(NULL),
+  discovery_enabled(false),
+  discovery_announce(false),
   network_enabled(false),
   server_enabled(false),
   reconnect_attempts(DEFAULT_ATTEMPTS),
@@ -90,6 +133,7 @@ DistributionSocketLink::~DistributionSocketLink()
   g_free(username);
   g_free(password);
   delete server_socket;
+  delete discovery_socket;
   delete socket_driver;
 }
 
@@ -156,10 +200,44 @@ DistributionSocketLink::heartbeat()
           i++;
         }
 
-      // Periodically distribute state, in case the master crashes.
+      // Close connections of clients that cannot keep up.
+      list<Client *> overflowed;
+      for (i = clients.begin(); i != clients.end(); i++)
+        {
+          if ((*i)->socket != NULL && (*i)->outbound_overflow)
+            {
+              overflowed.push_back(*i);
+            }
+        }
+
+      for (i = overflowed.begin(); i != overflowed.end(); i++)
+        {
+          Client *c = *i;
+          if (is_client_valid(c) && c->socket != NULL)
+            {
+              dist_manager->log(_("Client %s is too slow, closing."),
+                                c->id == NULL ? "Unknown" : c->id);
+              clear_outbound(c);
+              close_client(c, c->outbound);
+            }
+        }
+
+      // Announce myself to, and connect to, peers on the local network.
+      if (discovery_socket != NULL)
+        {
+          if (discovery_announce || heartbeat_count % DISCOVERY_INTERVAL == 0)
+            {
+              send_announcement();
+            }
+          connect_discovered_peers();
+        }
+
+      // Periodically distribute changed state, in case the master crashes.
       if (heartbeat_count % 30 == 0 && i_am_master)
         {
-          send_client_message(DCMT_MASTER);
+          // WORKRAVE_FULL_STATE lets a load test measure the traffic without deltas.
+          bool full = (heartbeat_count % (30 * FULL_STATE_INTERVAL) == 0 || getenv("WORKRAVE_FULL_STATE") != NULL);
+          send_client_message(DCMT_MASTER, !full);
         }
       TRACE_EXIT();
     }
@@ -212,6 +290,51 @@ DistributionSocketLink::get_my_id() const
 }
 
 
+//! Returns the number of bytes queued for each connected peer.
+map<string, int>
+DistributionSocketLink::get_peer_queue_sizes()
+{
+  map<string, int> ret;
+
+  list<Client *>::iterator i = clients.begin();
+  while (i != clients.end())
+    {
+      Client *c = *i;
+      if (c->socket != NULL && c->id != NULL)
+        {
+          ret[c->id] = c->outbound_size;
+        }
+      i++;
+    }
+
+  return ret;
+}
+
+
+//! Returns the number of packets and bytes sent and received.
+void
+DistributionSocketLink::get_packet_counts(int &packets_sent, int &packets_received,
+                                          int &bytes_sent, int &bytes_received)
+{
+  guint32 packets_out, packets_in;
+  guint64 bytes_out, bytes_in;
+  metrics.get_totals(DistributionMetrics::KIND_PACKET, packets_out, packets_in, bytes_out, bytes_in);
+
+  packets_sent = packets_out;
+  packets_received = packets_in;
+  bytes_sent = (int) bytes_out;
+  bytes_received = (int) bytes_in;
+}
+
+
+//! Returns the traffic and handling time per packet and client message.
+void
+DistributionSocketLink::get_message_metrics(DistributionMessageMetricsList &metrics)
+{
+  this->metrics.get_metrics(metrics);
+}
+
+
 //! Returns the total number of peer in the network.
 int
 DistributionSocketLink::get_number_of_peers()
@@ -456,6 +579,7 @@ DistributionSocketLink::set_server_enabled(bool enabled)
     }
 
   server_enabled = enabled;
+  update_discovery();
   TRACE_EXIT();
   return ret;
 }
@@ -494,17 +618,7 @@ DistributionSocketLink::broadcast_client_message(DistributionClientMessageID dsi
   TRACE_ENTER("DistributionSocketLink::broadcast_client_message");
 
   PacketBuffer packet;
-  packet.create();
-  init_packet(packet, PACKET_CLIENTMSG);
-
-  string id = get_master();
-  packet.pack_string(id);
-
-  packet.pack_ushort(1);
-  packet.pack_ushort(dsid);
-  packet.pack_ushort(buffer.bytes_written());
-  packet.pack_raw((unsigned char *)buffer.get_buffer(),
-                  buffer.bytes_written());
+  init_client_message_packet(packet, dsid, buffer);
 
   send_packet_broadcast(packet);
   TRACE_EXIT();
@@ -512,6 +626,42 @@ DistributionSocketLink::broadcast_client_message(DistributionClientMessageID dsi
 }
 
 
+//! Sends a client message to a single client.
+bool
+DistributionSocketLink::unicast_client_message(DistributionClientMessageID dsid, const string &client_id,
+                                               PacketBuffer &buffer)
+{
+  TRACE_ENTER_MSG("DistributionSocketLink::unicast_client_message", client_id);
+  bool ret = false;
+
+  Client *client = find_client_by_id((gchar *)client_id.c_str());
+  if (client != NULL && client->type != CLIENTTYPE_SIGNEDOFF)
+    {
+      PacketBuffer packet;
+      init_client_message_packet(packet, dsid, buffer);
+
+      Client *connection = get_connection(client);
+      if (connection == NULL || !connection->welcome)
+        {
+          // The connection would ignore the message.
+          TRACE_MSG("Not welcome yet");
+        }
+      else if (!connection->long_framing && packet.bytes_written() > 0xffff)
+        {
+          dist_manager->log(_("Message too large for client %s, not sending."), client_id.c_str());
+        }
+      else
+        {
+          send_packet_addressed(client, packet);
+          ret = true;
+        }
+    }
+
+  TRACE_RETURN(ret);
+  return ret;
+}
+
+
 //! Returns whether the specified client is this client.
 bool
 DistributionSocketLink::client_is_me(gchar *id)
@@ -544,6 +694,21 @@ DistributionSocketLink::exists_client(gchar *id)
 }
 
 
+//! Returns whether the specified peer is, or is being, connected.
+bool
+DistributionSocketLink::is_client_reachable(gchar *id, const std::string &host, gint port)
+{
+  Client *c = find_client_by_id(id);
+  if (c != NULL && (c->socket != NULL || c->type == CLIENTTYPE_ROUTED))
+    {
+      return true;
+    }
+
+  c = find_client_by_canonicalname((gchar *)host.c_str(), port);
+  return c != NULL && c->socket != NULL;
+}
+
+
 //! Adds a new client and connect to it.
 bool
 DistributionSocketLink::add_client(gchar *id, gchar *host, gint port, ClientType type, Client *peer)
@@ -591,7 +756,7 @@ DistributionSocketLink::add_client(gchar *id, gchar *host, gint port, ClientType
       client->id = g_strdup(id);
       client->port = port;
 
-      clients.push_back(client);
+      insert_client(client);
 
       if (client->id != NULL)
         {
@@ -679,11 +844,13 @@ DistributionSocketLink::set_client_id(Client *client, gchar *id)
   if (ret)
     {
       // No duplicate, so change the canonical name.
+      unindex_client_id(client);
       g_free(client->id);
       g_free(client->hostname);
       client->id = g_strdup(id);
       client->hostname = NULL;
       client->port = 0;
+      index_client_id(client);
 
       if (client->id != NULL)
         {
@@ -720,6 +887,7 @@ DistributionSocketLink::remove_client(Client *client)
 
           dist_manager->log(_("Removing client %s."),
                             (*i)->id == NULL ? "Unknown" : (*i)->id);
+          unindex_client(*i);
           delete *i;
           i = clients.erase(i);
         }
@@ -766,6 +934,7 @@ DistributionSocketLink::remove_peer_clients(Client *client)
               set_master(NULL);
             }
 
+          unindex_client(*i);
           delete *i;
           i = clients.erase(i);
         }
@@ -856,19 +1025,65 @@ DistributionSocketLink::close_client(Client *client, bool reconnect /* = false*/
 bool
 DistributionSocketLink::is_client_valid(Client *client)
 {
-  list<Client *>::iterator i = clients.begin();
-  bool ret = false;
+  return client_set.find(client) != client_set.end();
+}
+
+
+//! Adds a client to the list of clients.
+void
+DistributionSocketLink::insert_client(Client *client)
+{
+  clients.push_back(client);
+  client_set.insert(client);
+  index_client_id(client);
+}
 
-  while (!ret && i != clients.end())
+
+//! Removes a client from the indices. The client must still be in the list.
+void
+DistributionSocketLink::unindex_client(Client *client)
+{
+  client_set.erase(client);
+  unindex_client_id(client);
+}
+
+
+//! Adds the id of a client to the index.
+void
+DistributionSocketLink::index_client_id(Client *client)
+{
+  if (client->id != NULL)
     {
-      if (*i == client)
+      client_ids[client->id] = client;
+    }
+}
+
+
+//! Removes the id of a client from the index.
+void
+DistributionSocketLink::unindex_client_id(Client *client)
+{
+  if (client->id == NULL)
+    {
+      return;
+    }
+
+  map<string, Client *>::iterator it = client_ids.find(client->id);
+  if (it != client_ids.end() && it->second == client)
+    {
+      client_ids.erase(it);
+
+      // Another client may have the same id.
+      list<Client *>::iterator i = clients.begin();
+      while (i != clients.end())
         {
-          ret = true;
+          if (*i != client && (*i)->id != NULL && strcmp((*i)->id, client->id) == 0)
+            {
+              client_ids[client->id] = *i;
+            }
+          i++;
         }
-      i++;
     }
-
-  return ret;
 }
 
 
@@ -895,15 +1110,14 @@ DistributionSocketLink::Client *
 DistributionSocketLink::find_client_by_id(gchar *id)
 {
   Client *ret = NULL;
-  list<Client *>::iterator i = clients.begin();
 
-  while (i != clients.end())
+  if (id != NULL)
     {
-      if ((*i)->id != NULL && strcmp((*i)->id, id) == 0)
+      map<string, Client *>::iterator i = client_ids.find(id);
+      if (i != client_ids.end())
         {
-          ret = *i;
+          ret = i->second;
         }
-      i++;
     }
   return ret;
 }
@@ -1005,6 +1219,27 @@ DistributionSocketLink::init_packet(PacketBuffer &packet, PacketCommand cmd)
 }
 
 
+//! Creates a packet that holds a single client message.
+void
+DistributionSocketLink::init_client_message_packet(PacketBuffer &packet, DistributionClientMessageID dsid,
+                                                   PacketBuffer &buffer)
+{
+  packet.create();
+  init_packet(packet, PACKET_CLIENTMSG);
+
+  string id = get_master();
+  packet.pack_string(id);
+
+  int pos = 0;
+  packet.pack_ushort(1);
+  packet.pack_ushort(dsid);
+  packet.reserve_size(pos);
+  packet.pack_raw((unsigned char *)buffer.get_buffer(),
+                  buffer.bytes_written());
+  packet.update_size(pos);
+}
+
+
 //! Sends the specified packet to all clients.
 void
 DistributionSocketLink::send_packet_broadcast(PacketBuffer &packet)
@@ -1019,15 +1254,10 @@ DistributionSocketLink::send_packet_broadcast(PacketBuffer &packet)
 
 //! Sends the specified packet to all clients with the exception of one client.
 void
-DistributionSocketLink::send_packet_except(PacketBuffer &packet, Client *client)
+DistributionSocketLink::send_packet_except(PacketBuffer &packet, Client *client, Client *source)
 {
   TRACE_ENTER("DistributionSocketLink::send_packet_except");
 
-  gint size = packet.bytes_written();
-
-  // Length.
-  packet.poke_ushort(0, size);
-
   list<Client *>::iterator i = clients.begin();
   while (i != clients.end())
     {
@@ -1035,15 +1265,7 @@ DistributionSocketLink::send_packet_except(PacketBuffer &packet, Client *client)
 
       if (c != client && c->socket != NULL)
         {
-          int bytes_written = 0;
-          try
-            {
-              c->socket->write(packet.get_buffer(), size, bytes_written);
-            }
-          catch (SocketException)
-            {
-              TRACE_MSG("Failed to send");
-            }
+          write_packet(c, packet, source != NULL ? source->id : NULL, NULL);
         }
       i++;
     }
@@ -1054,10 +1276,12 @@ DistributionSocketLink::send_packet_except(PacketBuffer &packet, Client *client)
 
 //! Sends the specified packet to the specified client.
 void
-DistributionSocketLink::send_packet(Client *client, PacketBuffer &packet)
+DistributionSocketLink::send_packet(Client *client, PacketBuffer &packet, Client *source)
 {
   TRACE_ENTER("DistributionSocketLink::send_packet");
 
+  gchar *dest_id = NULL;
+
   if (client != NULL && client->type == CLIENTTYPE_ROUTED)
     {
       TRACE_MSG("Must route packet.");
@@ -1067,47 +1291,435 @@ DistributionSocketLink::send_packet(Client *client, PacketBuffer &packet)
           TRACE_MSG("Client's ID == NULL");
         }
 
-      packet.restart_read();
-      int flags = packet.peek_byte(3);
+      dest_id = client->id;
+      client = client->peer;
+    }
+
+  if (client != NULL && client->socket != NULL)
+    {
+      if (client->id != NULL)
+        {
+          TRACE_MSG("Sending to " << client->id);
+        }
+
+      write_packet(client, packet, source != NULL ? source->id : NULL, dest_id);
+    }
+
+  TRACE_EXIT();
+}
+
+
+//! Sends the specified packet to a single client, which does not forward it.
+void
+DistributionSocketLink::send_packet_addressed(Client *client, PacketBuffer &packet)
+{
+  if (client->type == CLIENTTYPE_ROUTED)
+    {
+      send_packet(client, packet);
+    }
+  else if (client->socket != NULL)
+    {
+      // Without a destination, the client would forward the packet to all others.
+      write_packet(client, packet, NULL, client->id);
+    }
+}
+
+
+//! Returns the direct connection through which the client is reached.
+DistributionSocketLink::Client *
+DistributionSocketLink::get_connection(Client *client) const
+{
+  return client->type == CLIENTTYPE_ROUTED ? client->peer : client;
+}
+
+
+//! Writes the packet to a direct connection, adding the routing information.
+/*!
+ *  The source and destination are only added if the packet does not
+ *  have them yet. They are written as separate segments, so the packet
+ *  itself is not modified and its payload is never moved.
+ */
+void
+DistributionSocketLink::write_packet(Client *client, PacketBuffer &packet,
+                                     const gchar *source_id, const gchar *dest_id)
+{
+  if (client->outbound_overflow)
+    {
+      // A packet was lost; the connection is closed at the next heartbeat.
+      forget_delivered_state(client);
+      return;
+    }
+
+  guint8 *data = (guint8 *) packet.get_buffer();
+  int size = packet.bytes_written();
+  int flags = data[3];
+
+  PacketBuffer route;
+  route.create();
+
+  // Offset in the packet at which the routing information is written.
+  int pos = 4;
+
+  if (flags & PACKETFLAG_SOURCE)
+    {
+      // The destination follows the existing source.
+      pos += ((data[4] << 8) + data[5]) + 2;
+    }
+  else if (source_id != NULL)
+    {
+      TRACE_MSG("Add source " << source_id);
+      flags |= PACKETFLAG_SOURCE;
+      route.pack_string(source_id);
+    }
+
+  if (!(data[3] & PACKETFLAG_DEST) && dest_id != NULL)
+    {
+      TRACE_MSG("Add destination " << dest_id);
+      flags |= PACKETFLAG_DEST;
+      route.pack_string(dest_id);
+    }
+
+  int total_size = size + route.bytes_written();
+  int header_size = PACKET_HEADER_SIZE;
+
+  guint8 header[PACKET_HEADER_SIZE_LONG];
+  if (total_size <= 0xffff)
+    {
+      header[0] = (total_size >> 8) & 0xff;
+      header[1] = total_size & 0xff;
+    }
+  else if (client->long_framing)
+    {
+      header_size = PACKET_HEADER_SIZE_LONG;
+      total_size += PACKET_HEADER_SIZE_LONG - PACKET_HEADER_SIZE;
+
+      header[0] = 0;
+      header[1] = 0;
+      header[4] = (total_size >> 24) & 0xff;
+      header[5] = (total_size >> 16) & 0xff;
+      header[6] = (total_size >> 8) & 0xff;
+      header[7] = total_size & 0xff;
+    }
+  else
+    {
+      dist_manager->log(_("Packet too large for client %s, dropping."),
+                        client->id == NULL ? "Unknown" : client->id);
+      forget_delivered_state(client);
+      return;
+    }
+  header[2] = data[2];
+  header[3] = flags;
+
+  SocketVector vec[4];
+  int count = 0;
+
+  vec[count].buf = header;
+  vec[count++].count = header_size;
+
+  if (pos > 4)
+    {
+      vec[count].buf = data + 4;
+      vec[count++].count = pos - 4;
+    }
+
+  if (route.bytes_written() > 0)
+    {
+      vec[count].buf = route.get_buffer();
+      vec[count++].count = route.bytes_written();
+    }
+
+  vec[count].buf = data + pos;
+  vec[count++].count = size - pos;
+
+  record_sent_packet(data, size, total_size);
+
+  if (!client->outbound_queue.empty())
+    {
+      // Preserve the order of the packets.
+      queue_packet(client, vec, count, 0);
+      return;
+    }
+
+  int bytes_written = 0;
+  try
+    {
+      client->socket->write_vector(vec, count, bytes_written);
+    }
+  catch (SocketException)
+    {
+      TRACE_MSG("Failed to send");
+      forget_delivered_state(client);
+      return;
+    }
+
+  if (bytes_written < total_size)
+    {
+      queue_packet(client, vec, count, bytes_written);
+    }
+}
+
+
+//! Records the command and the client messages of a packet that is sent.
+/*!
+ *  The packet is parsed as it is stored before the routing information
+ *  of this connection is added; wire_size is the size that is sent.
+ */
+void
+DistributionSocketLink::record_sent_packet(const guint8 *data, int size, int wire_size)
+{
+  int pos = PACKET_HEADER_SIZE;
+  int flags = data[3];
+
+  for (int flag = PACKETFLAG_SOURCE; flag <= PACKETFLAG_DEST; flag <<= 1)
+    {
+      if ((flags & flag) && pos + 2 <= size)
+        {
+          pos += ((data[pos] << 8) + data[pos + 1]) + 2;
+        }
+    }
+
+  // Malformed packets are counted as unknown.
+  int cmd = pos + 2 <= size ? (data[pos] << 8) + data[pos + 1] : 0;
+  metrics.sent(DistributionMetrics::KIND_PACKET, cmd, get_command_name(cmd), wire_size);
+  pos += 2;
+
+  if (cmd != PACKET_CLIENTMSG || pos + 2 > size)
+    {
+      return;
+    }
+
+  // Skip master id.
+  pos += ((data[pos] << 8) + data[pos + 1]) + 2;
+  if (pos + 2 > size)
+    {
+      return;
+    }
+
+  int count = (data[pos] << 8) + data[pos + 1];
+  pos += 2;
+
+  for (int i = 0; i < count && pos + 4 <= size; i++)
+    {
+      int id = (data[pos] << 8) + data[pos + 1];
+      int datalen = (data[pos + 2] << 8) + data[pos + 3];
+      pos += 4;
+
+      if (datalen == PacketBuffer::LONG_SIZE)
+        {
+          if (pos + 4 > size)
+            {
+              return;
+            }
+          datalen = (data[pos] << 24) + (data[pos + 1] << 16) + (data[pos + 2] << 8) + data[pos + 3];
+          pos += 4;
+        }
+
+      metrics.sent(DistributionMetrics::KIND_CLIENT_MESSAGE, id, get_client_message_name(id), datalen);
+      pos += datalen;
+    }
+}
+
+
+//! Queues the part of a packet that could not be written yet.
+/*!
+ *  A state message that was not sent at all replaces the older state
+ *  message of the same kind, so that a slow client only receives the
+ *  most recent state. State messages are dropped if the queue is full.
+ *  Any other packet that does not fit marks the queue as overflowed;
+ *  the connection is closed at the next heartbeat. The rest of a packet
+ *  that was partly written is always queued, so that the stream never
+ *  ends in the middle of a packet.
+ */
+void
+DistributionSocketLink::queue_packet(Client *client, const SocketVector *vec, int count, int bytes_written)
+{
+  TRACE_ENTER_MSG("DistributionSocketLink::queue_packet", bytes_written << " " << client->outbound_size);
+
+  OutboundPacket packet;
+  for (int i = 0; i < count; i++)
+    {
+      packet.data.append((const char *) vec[i].buf, vec[i].count);
+    }
+
+  if (bytes_written == 0)
+    {
+      packet.key = get_state_key(packet.data);
+    }
+  packet.data.erase(0, bytes_written);
 
-      if (!(flags & PACKETFLAG_DEST) && client->id != NULL)
+  if (!packet.key.empty())
+    {
+      list<OutboundPacket>::iterator i = client->outbound_queue.begin();
+      while (i != client->outbound_queue.end())
         {
-          assert(!(flags & PACKETFLAG_SOURCE));
+          if (i->key == packet.key)
+            {
+              TRACE_MSG("Replacing state message");
+              // The replacement only carries the state that changed since.
+              forget_delivered_state(client);
+              client->outbound_size -= i->data.size();
+              client->outbound_queue.erase(i);
+              break;
+            }
+          i++;
+        }
+    }
 
-          TRACE_MSG("Add destination " << client->id);
+  if (bytes_written == 0 && client->outbound_size + (int)packet.data.size() > MAX_OUTBOUND_SIZE)
+    {
+      forget_delivered_state(client);
+      if (packet.key.empty())
+        {
+          TRACE_MSG("Outbound queue overflow");
+          client->outbound_overflow = true;
+        }
+      TRACE_RETURN("Dropped");
+      return;
+    }
+
+  client->outbound_size += packet.data.size();
+  client->outbound_queue.push_back(packet);
+  client->socket->set_notify_writable(true);
 
-          packet.poke_byte(3, flags | PACKETFLAG_DEST);
+  TRACE_EXIT();
+}
+
+
+//! Writes as much of the outbound queue as the socket accepts.
+void
+DistributionSocketLink::flush_outbound(Client *client)
+{
+  TRACE_ENTER_MSG("DistributionSocketLink::flush_outbound", client->outbound_size);
 
-          packet.insert(4, strlen(client->id) + 2);
-          packet.poke_string(6, client->id);
+  while (!client->outbound_queue.empty())
+    {
+      OutboundPacket &packet = client->outbound_queue.front();
+
+      int bytes_written = 0;
+      try
+        {
+          client->socket->write((void *) packet.data.data(), packet.data.size(), bytes_written);
         }
-      client = client->peer;
+      catch (SocketException)
+        {
+          TRACE_MSG("Failed to send");
+          clear_outbound(client);
+          break;
+        }
+
+      client->outbound_size -= bytes_written;
+
+      if (bytes_written < (int)packet.data.size())
+        {
+          packet.data.erase(0, bytes_written);
+          if (bytes_written > 0)
+            {
+              // Partially sent packets can no longer be replaced.
+              packet.key = "";
+            }
+          break;
+        }
+
+      client->outbound_queue.pop_front();
     }
 
-  if (client != NULL && client->socket != NULL)
+  client->socket->set_notify_writable(!client->outbound_queue.empty());
+
+  TRACE_EXIT();
+}
+
+
+//! Discards all packets queued for the specified client.
+void
+DistributionSocketLink::clear_outbound(Client *client)
+{
+  client->outbound_queue.clear();
+  client->outbound_size = 0;
+  client->outbound_overflow = false;
+  forget_delivered_state(client);
+
+  if (client->socket != NULL)
+    {
+      client->socket->set_notify_writable(false);
+    }
+}
+
+
+//! Marks all state as not delivered to the client.
+/*!
+ *  Called when a packet to the client is lost, so that the next
+ *  periodic sync sends all state to it again. The packet may have been
+ *  addressed to any client that is reached through this connection.
+ */
+void
+DistributionSocketLink::forget_delivered_state(Client *client)
+{
+  client->state_versions.clear();
+
+  for (list<Client *>::iterator i = clients.begin(); i != clients.end(); i++)
+    {
+      if ((*i)->type == CLIENTTYPE_ROUTED && (*i)->peer == client)
+        {
+          (*i)->state_versions.clear();
+        }
+    }
+}
+
+
+//! Returns the key of a state message that can be replaced by a newer one.
+/*!
+ *  Only client messages that carry a single state of the timers, the
+ *  activity monitor or the statistics are replaceable. The key consists
+ *  of the routing information and the message id.
+ */
+std::string
+DistributionSocketLink::get_state_key(const std::string &data) const
+{
+  const guint8 *p = (const guint8 *) data.data();
+  int size = data.size();
+  int pos = PACKET_HEADER_SIZE;
+
+  if (size < pos)
+    {
+      return "";
+    }
+
+  if (p[0] == 0 && p[1] == 0)
+    {
+      pos = PACKET_HEADER_SIZE_LONG;
+    }
+  int header_size = pos;
+
+  int flags = p[3];
+  for (int flag = PACKETFLAG_SOURCE; flag <= PACKETFLAG_DEST; flag <<= 1)
     {
-      if (client->id != NULL)
+      if ((flags & flag) && pos + 2 <= size)
         {
-          TRACE_MSG("Sending to " << client->id);
+          pos += ((p[pos] << 8) + p[pos + 1]) + 2;
         }
+    }
 
-      gint size = packet.bytes_written();
+  if (pos + 4 > size || ((p[pos] << 8) + p[pos + 1]) != PACKET_CLIENTMSG)
+    {
+      return "";
+    }
 
-      // Length.
-      packet.poke_ushort(0, size);
+  // Skip command and master id.
+  int routing_size = pos + 2;
+  pos += ((p[routing_size] << 8) + p[routing_size + 1]) + 4;
 
-      int bytes_written = 0;
-      try
-        {
-          client->socket->write(packet.get_buffer(), size, bytes_written);
-        }
-      catch (SocketException)
-        {
-          TRACE_MSG("Failed to send");
-        }
+  if (pos + 4 > size || ((p[pos] << 8) + p[pos + 1]) != 1)
+    {
+      return "";
     }
 
-  TRACE_EXIT();
+  int id = (p[pos + 2] << 8) + p[pos + 3];
+  if (id != DCM_TIMERS && id != DCM_MONITOR && id != DCM_STATS)
+    {
+      return "";
+    }
+
+  return data.substr(header_size, routing_size - header_size) + data.substr(pos + 2, 2);
 }
 
 
@@ -1120,8 +1732,9 @@ DistributionSocketLink::process_client_packet(Client *client)
 
   client->claim_count = 0;
 
-  gint size = packet.unpack_ushort();
-  g_assert(size == packet.bytes_written());
+  // The length is not valid for packets with long framing.
+  packet.skip(2);
+  gint size = packet.bytes_written();
 
   gint version = packet.unpack_byte();
   gint flags = packet.unpack_byte();
@@ -1188,11 +1801,20 @@ DistributionSocketLink::process_client_packet(Client *client)
 
           source = NULL;
         }
-        g_free(id);
+      else
+        {
+          // Addressed to me only.
+          forward = false;
+        }
+      g_free(id);
     }
 
   TRACE_MSG("size = " << size << ", version = " << version << ", flags = " << flags);
 
+  metrics.received(DistributionMetrics::KIND_PACKET, type, get_command_name(type), size,
+                   (flags & PACKETFLAG_SOURCE) != 0);
+  gint64 start_time = g_get_monotonic_time();
+
   if (source != NULL || type == PACKET_CLIENT_LIST)
     {
       switch (type)
@@ -1242,18 +1864,27 @@ DistributionSocketLink::process_client_packet(Client *client)
           break;
         }
 
-      if (forward &&
-          find(clients.begin(), clients.end(), client) != clients.end())
+      if (forward && is_client_valid(client))
         {
           forward_packet_except(packet, client, source);
         }
     }
 
-  if (find(clients.begin(), clients.end(), client) != clients.end())
+  metrics.handled(DistributionMetrics::KIND_PACKET, type, g_get_monotonic_time() - start_time);
+
+  if (is_client_valid(client))
     {
       // hack... client may have been removed...
-      packet.clear();
-      packet.resize(0);
+      // A default size buffer is kept for the next packet, a larger one is
+      // returned to the pool.
+      if (packet.get_buffer_size() > PacketBuffer::DEFAULT_SIZE)
+        {
+          packet.create();
+        }
+      else
+        {
+          packet.clear();
+        }
     }
   
   TRACE_EXIT();
@@ -1264,18 +1895,7 @@ void
 DistributionSocketLink::forward_packet_except(PacketBuffer &packet, Client *client, Client *source)
 {
   TRACE_ENTER("DistributionSocketLink::forward_packet_except");
-
-  packet.restart_read();
-  int flags = packet.peek_byte(3);
-  if (!(flags &  PACKETFLAG_SOURCE) && source->id != NULL)
-    {
-      TRACE_MSG("Add source " << source->id);
-      packet.poke_byte(3, flags | PACKETFLAG_SOURCE);
-      packet.insert(4, strlen(source->id) + 2);
-      packet.poke_string(6, source->id);
-    }
-  send_packet_except(packet, client);
-
+  send_packet_except(packet, client, source);
   TRACE_EXIT();
 }
 
@@ -1284,17 +1904,7 @@ void
 DistributionSocketLink::forward_packet(PacketBuffer &packet, Client *dest, Client *source)
 {
   TRACE_ENTER("DistributionSocketLink::forward_packet");
-
-  packet.restart_read();
-  int flags = packet.peek_byte(3);
-  if (!(flags &  PACKETFLAG_SOURCE) && source->id != NULL)
-    {
-      TRACE_MSG("Add source " << source->id);
-      packet.poke_byte(3, flags | PACKETFLAG_SOURCE);
-      packet.insert(4, strlen(source->id) + 2);
-      packet.poke_string(6, source->id);
-    }
-  send_packet(dest, packet);
+  send_packet(dest, packet, source);
   TRACE_EXIT();
 }
 
@@ -1331,6 +1941,7 @@ DistributionSocketLink::send_hello1(Client *client)
   packet.pack_string(username);
   packet.pack_string(get_my_id());
   packet.pack_string(rnd);
+  packet.pack_byte(FRAMING_LONG);
 
   send_packet(client, packet);
   TRACE_EXIT();
@@ -1347,6 +1958,9 @@ DistributionSocketLink::handle_hello1(PacketBuffer &packet, Client *client)
   gchar *id = packet.unpack_string();
   gchar *rnd = packet.unpack_string();
 
+  // Older clients do not send the framing they can receive.
+  client->long_framing = packet.bytes_available() >= 1 && packet.unpack_byte() >= FRAMING_LONG;
+
   TRACE_MSG(user << " " << id << " " << rnd);
   
   dist_manager->log(_("Client %s saying hello."), id != NULL ? id : "Unknown");
@@ -1390,6 +2004,7 @@ DistributionSocketLink::send_hello2(Client *client, gchar *rnd)
   packet.pack_string(username);
   packet.pack_string(g_hmac_get_string(hmac));
   packet.pack_string(get_my_id());
+  packet.pack_byte(FRAMING_LONG);
 
   g_hmac_unref (hmac);
 
@@ -1408,6 +2023,9 @@ DistributionSocketLink::handle_hello2(PacketBuffer &packet, Client *client)
   gchar *pass = packet.unpack_string();
   gchar *id = packet.unpack_string();
 
+  // Older clients do not send the framing they can receive.
+  client->long_framing = packet.bytes_available() >= 1 && packet.unpack_byte() >= FRAMING_LONG;
+
   TRACE_MSG(user << " " << pass << " " << id << " " << client->challenge);
   
   dist_manager->log(_("Client %s saying hello."), id != NULL ? id : "Unknown");
@@ -2056,19 +2674,97 @@ DistributionSocketLink::handle_new_master(PacketBuffer &packet, Client *client)
 
 
 // Distributes the current client message.
+/*!
+ *  If delta is true, each client only receives the client messages whose
+ *  state changed since they were last sent to it, in a packet addressed to
+ *  that client. This includes clients that are reached through a peer.
+ *  TCP delivers these in order, so no acknowledgement is needed. A client
+ *  that just signed on has no recorded state and receives all of it.
+ */
 void
-DistributionSocketLink::send_client_message(DistributionClientMessageType type)
+DistributionSocketLink::send_client_message(DistributionClientMessageType type, bool delta)
 {
-  TRACE_ENTER("DistributionSocketLink:send_client_message");
+  TRACE_ENTER_MSG("DistributionSocketLink:send_client_message", type << " " << delta);
 
-  PacketBuffer packet;
+  // Update the state of all client messages.
+  ClientMessageMap::iterator i = client_message_map.begin();
+  while (i != client_message_map.end())
+    {
+      DistributionClientMessageID id = i->first;
+      ClientMessageListener &sl = i->second;
+
+      if ((sl.type & type) != 0)
+        {
+          TRACE_MSG("request " << id << " " << type);
+
+          PacketBuffer buffer;
+          buffer.create();
+          sl.listener->request_client_message(id, buffer);
+
+          string state(buffer.get_buffer(), buffer.bytes_written());
+          if (state != sl.state || sl.version == 0)
+            {
+              sl.state = state;
+              sl.version++;
+            }
+        }
+      i++;
+    }
+
+  if (!delta)
+    {
+      PacketBuffer packet;
+      pack_client_messages(packet, type, NULL);
+      send_packet_broadcast(packet);
+    }
+  else
+    {
+      list<Client *>::iterator ci = clients.begin();
+      while (ci != clients.end())
+        {
+          Client *c = *ci;
+          Client *connection = get_connection(c);
+
+          if (c->id != NULL && (c->type == CLIENTTYPE_DIRECT || c->type == CLIENTTYPE_ROUTED)
+              && connection != NULL && connection->socket != NULL && connection->welcome)
+            {
+              PacketBuffer packet;
+              if (pack_client_messages(packet, type, c) > 0)
+                {
+                  send_packet_addressed(c, packet);
+                }
+            }
+          ci++;
+        }
+    }
+
+  TRACE_EXIT();
+}
+
+
+//! Packs the client messages of the specified type.
+/*!
+ *  If client is NULL, all client messages are packed and the state is
+ *  recorded as sent to every client. Otherwise, only the messages that
+ *  the client did not receive yet are packed.
+ *
+ *  \return the number of client messages with state in the packet.
+ */
+int
+DistributionSocketLink::pack_client_messages(PacketBuffer &packet, DistributionClientMessageType type,
+                                             Client *client)
+{
   packet.create();
   init_packet(packet, PACKET_CLIENTMSG);
 
-  string id = get_master();
-  packet.pack_string(id);
+  string master_id = get_master();
+  packet.pack_string(master_id);
+
+  int count_pos = packet.bytes_written();
+  packet.pack_ushort(0);
 
-  packet.pack_ushort(client_message_map.size());
+  int count = 0;
+  int num_states = 0;
 
   ClientMessageMap::iterator i = client_message_map.begin();
   while (i != client_message_map.end())
@@ -2076,25 +2772,50 @@ DistributionSocketLink::send_client_message(DistributionClientMessageType type)
       DistributionClientMessageID id = i->first;
       ClientMessageListener &sl = i->second;
 
-      IDistributionClientMessage *itf = sl.listener;
+      bool has_state = (sl.type & type) != 0;
+      bool changed = (client == NULL || client->state_versions[id] != sl.version);
 
-      int pos = 0;
-      packet.pack_ushort(id);
-      packet.reserve_size(pos);
-
-      if ((sl.type & type) != 0)
+      if (has_state && client != NULL && !get_connection(client)->long_framing
+          && packet.bytes_written() + 4 + (int) sl.state.size() > 0xffff)
         {
-          TRACE_MSG("request " << id << " " << type);
-          itf->request_client_message(id, packet);
+          // Only fits in a packet with long framing.
+          TRACE_MSG("State " << id << " too large for client");
+          i++;
+          continue;
         }
 
-      packet.update_size(pos);
+      if ((has_state && changed) || client == NULL)
+        {
+          int pos = 0;
+          packet.pack_ushort(id);
+          packet.reserve_size(pos);
+
+          if (has_state)
+            {
+              packet.pack_raw((const guint8 *)sl.state.data(), sl.state.size());
+              num_states++;
+
+              if (client != NULL)
+                {
+                  client->state_versions[id] = sl.version;
+                }
+              else
+                {
+                  for (list<Client *>::iterator ci = clients.begin(); ci != clients.end(); ci++)
+                    {
+                      (*ci)->state_versions[id] = sl.version;
+                    }
+                }
+            }
 
+          packet.update_size(pos);
+          count++;
+        }
       i++;
     }
 
-  send_packet_broadcast(packet);
-  TRACE_EXIT();
+  packet.poke_ushort(count_pos, count);
+  return num_states;
 }
 
 
@@ -2140,10 +2861,16 @@ DistributionSocketLink::handle_client_message(PacketBuffer &packet, Client *clie
           // Narrow the buffer to the client message data.
           packet.narrow(-1, datalen);
 
+          metrics.received(DistributionMetrics::KIND_CLIENT_MESSAGE, id, get_client_message_name(id),
+                           datalen, client->type == CLIENTTYPE_ROUTED);
+
           ClientMessageMap::iterator it = client_message_map.find(id);
           if (it != client_message_map.end())
             {
-              client_message_map[id].listener->client_message(id, will_i_become_master, client->id, packet);
+              gint64 start_time = g_get_monotonic_time();
+              it->second.listener->client_message(id, will_i_become_master, client->id, packet);
+              metrics.handled(DistributionMetrics::KIND_CLIENT_MESSAGE, id,
+                              g_get_monotonic_time() - start_time);
             }
 
           packet.narrow(0, -1);
@@ -2184,6 +2911,171 @@ DistributionSocketLink::start_async_server()
 }
 
 
+//! Starts or stops discovery of peers on the local network.
+/*!
+ *  Discovery is only active while listening for connections; otherwise
+ *  discovered peers could not connect back.
+ */
+void
+DistributionSocketLink::update_discovery()
+{
+  TRACE_ENTER("DistributionSocketLink::update_discovery");
+  bool enabled = discovery_enabled && server_socket != NULL;
+
+  if (enabled && discovery_socket == NULL)
+    {
+      discovery_socket = socket_driver->create_multicast_socket();
+      if (discovery_socket != NULL)
+        {
+          try
+            {
+              discovery_socket->set_listener(this);
+              discovery_socket->join(DISCOVERY_GROUP, DISCOVERY_PORT);
+              discovery_announce = true;
+              dist_manager->log(_("Discovering peers on the local network."));
+            }
+          catch(SocketException e)
+            {
+              delete discovery_socket;
+              discovery_socket = NULL;
+              dist_manager->log(_("Could not discover peers on the local network."));
+            }
+        }
+      else
+        {
+          dist_manager->log(_("Discovery of peers is not supported."));
+        }
+    }
+  else if (!enabled && discovery_socket != NULL)
+    {
+      delete discovery_socket;
+      discovery_socket = NULL;
+      discovered_peers.clear();
+    }
+
+  TRACE_EXIT();
+}
+
+
+//! Announces myself to the peers on the local network.
+void
+DistributionSocketLink::send_announcement()
+{
+  TRACE_ENTER("DistributionSocketLink::send_announcement");
+
+  PacketBuffer packet;
+  packet.create();
+
+  packet.pack_ulong(DISCOVERY_MAGIC);
+  packet.pack_byte(DISCOVERY_VERSION);
+  packet.pack_string(get_my_id());
+  packet.pack_ushort(server_port);
+  packet.pack_string(username);
+  packet.pack_byte(i_am_master);
+
+  try
+    {
+      discovery_socket->send(packet.get_buffer(), packet.bytes_written());
+    }
+  catch(SocketException e)
+    {
+      TRACE_MSG("Failed to send announcement");
+    }
+
+  discovery_announce = false;
+  TRACE_EXIT();
+}
+
+
+//! Connects to the discovered peers whose connect time has come.
+void
+DistributionSocketLink::connect_discovered_peers()
+{
+  DiscoveredPeers::iterator i = discovered_peers.begin();
+  while (i != discovered_peers.end())
+    {
+      DiscoveredPeers::iterator next = i;
+      next++;
+
+      DiscoveredPeer &peer = i->second;
+      if (heartbeat_count >= peer.connect_heartbeat)
+        {
+          if (!is_client_reachable((gchar *)i->first.c_str(), peer.host, peer.port))
+            {
+              dist_manager->log(_("Discovered %s."), i->first.c_str());
+              add_client(NULL, (gchar *)peer.host.c_str(), peer.port, CLIENTTYPE_DIRECT);
+            }
+          discovered_peers.erase(i);
+        }
+      i = next;
+    }
+}
+
+
+//! A peer announced itself on the local network.
+/*!
+ *  Only the peer with the smallest id connects, so that two peers that
+ *  discover each other do not connect twice. The connect is delayed by a
+ *  random number of heartbeats, unless the peer is the master, so that a
+ *  restarted peer is not contacted by all others at the same time.
+ */
+void
+DistributionSocketLink::multicast_received(IMulticastSocket *socket, const std::string &host,
+                                           const void *buf, int count)
+{
+  TRACE_ENTER_MSG("DistributionSocketLink::multicast_received", host << " " << count);
+  (void) socket;
+
+  PacketBuffer packet;
+  packet.create(count);
+  packet.pack_raw((const guint8 *)buf, count);
+
+  gchar *id = NULL;
+  gchar *user = NULL;
+
+  if (packet.bytes_available() >= 5 &&
+      packet.unpack_ulong() == DISCOVERY_MAGIC &&
+      packet.unpack_byte() == DISCOVERY_VERSION)
+    {
+      id = packet.unpack_string();
+      int port = packet.bytes_available() >= 2 ? packet.unpack_ushort() : 0;
+      user = packet.unpack_string();
+      bool master = packet.bytes_available() >= 1 && packet.unpack_byte() != 0;
+
+      string my_user = username != NULL ? username : "";
+
+      if (id == NULL || user == NULL || port == 0 || client_is_me(id) || my_user != user)
+        {
+          TRACE_MSG("Ignoring announcement");
+        }
+      else if (is_client_reachable(id, host, port))
+        {
+          TRACE_MSG("Already connected to " << id);
+        }
+      else if (get_my_id() > id)
+        {
+          // The peer connects to me once it knows about me.
+          discovery_announce = true;
+        }
+      else if (discovered_peers.find(id) == discovered_peers.end())
+        {
+          DiscoveredPeer &peer = discovered_peers[id];
+          peer.host = host;
+          peer.port = port;
+          peer.connect_heartbeat = heartbeat_count;
+          if (!master)
+            {
+              peer.connect_heartbeat += g_random_int_range(0, DISCOVERY_INTERVAL);
+            }
+        }
+    }
+
+  g_free(id);
+  g_free(user);
+  TRACE_EXIT();
+}
+
+
 void
 DistributionSocketLink::socket_accepted(ISocketServer *scon, ISocket *ccon)
 {
@@ -2209,7 +3101,7 @@ DistributionSocketLink::socket_accepted(ISocketServer *scon, ISocket *ccon)
 
       ccon->set_data(client);
       ccon->set_listener(this);
-      clients.push_back(client);
+      insert_client(client);
 
       send_hello1(client);
     }
@@ -2235,31 +3127,31 @@ DistributionSocketLink::socket_io(ISocket *con, void *data)
     }
 
   int bytes_read = 0;
-  int bytes_to_read = 4;
+  int bytes_to_read = 0;
 
   TRACE_MSG("2 " << client->packet.bytes_available() );
 
-  if (client->packet.bytes_available() >= 4)
+  if (client->packet_size != 0)
     {
-      TRACE_MSG("3");
-
-      bytes_to_read = client->packet.peek_ushort(0) - 4;
-
-      TRACE_MSG("4 " << bytes_to_read);
-
-      if (bytes_to_read + 4 > client->packet.get_buffer_size())
-        {
-          TRACE_MSG("5 " << bytes_to_read << " " << client->packet.get_buffer_size());
-          // FIXME: the 1024 is lame...
-          client->packet.resize(bytes_to_read + 4 + 1024);
-        }
+      bytes_to_read = client->packet_size - client->packet.bytes_written();
+    }
+  else if (client->packet.bytes_written() >= 2 && client->packet.peek_ushort(0) == 0)
+    {
+      bytes_to_read = PACKET_HEADER_SIZE_LONG - client->packet.bytes_written();
+    }
+  else
+    {
+      bytes_to_read = PACKET_HEADER_SIZE - client->packet.bytes_written();
     }
 
-  TRACE_MSG("5");
-  bool ok = true;
+  TRACE_MSG("5 " << bytes_to_read);
+  bool ok = bytes_to_read > 0;
   try
     {
-      con->read(client->packet.get_write_ptr(), bytes_to_read, bytes_read);
+      if (ok)
+        {
+          con->read(client->packet.get_write_ptr(), bytes_to_read, bytes_read);
+        }
     }
   catch (SocketException)
     {
@@ -2283,8 +3175,16 @@ DistributionSocketLink::socket_io(ISocket *con, void *data)
       g_assert(bytes_read > 0);
       client->packet.write_ptr += bytes_read;
 
-      if (client->packet.peek_ushort(0) == client->packet.bytes_written())
+      if (client->packet_size == 0 && !read_packet_size(client))
         {
+          dist_manager->log(_("Client %s sent an invalid packet, closing."),
+                            client->id == NULL ? "Unknown" : client->id);
+          ret = false;
+        }
+      else if (client->packet_size != 0 &&
+               client->packet_size == client->packet.bytes_written())
+        {
+          client->packet_size = 0;
           process_client_packet(client);
         }
     }
@@ -2299,6 +3199,57 @@ DistributionSocketLink::socket_io(ISocket *con, void *data)
 }
 
 
+//! Determines the size of the packet being received, once its header is complete.
+/*!
+ *  The buffer is resized to hold the complete packet at once. The long
+ *  length of a packet with long framing is removed from the buffer, so
+ *  that all received packets have the same layout.
+ *
+ *  \return false if the packet size is invalid.
+ */
+bool
+DistributionSocketLink::read_packet_size(Client *client)
+{
+  PacketBuffer &packet = client->packet;
+  int written = packet.bytes_written();
+
+  if (written < PACKET_HEADER_SIZE)
+    {
+      return true;
+    }
+
+  int size = packet.peek_ushort(0);
+  if (size == 0)
+    {
+      if (written < PACKET_HEADER_SIZE_LONG)
+        {
+          return true;
+        }
+
+      guint32 long_size = packet.peek_ulong(PACKET_HEADER_SIZE);
+      if (long_size < PACKET_HEADER_SIZE_LONG || long_size > MAX_PACKET_SIZE)
+        {
+          return false;
+        }
+
+      packet.write_ptr -= PACKET_HEADER_SIZE_LONG - PACKET_HEADER_SIZE;
+      size = long_size - (PACKET_HEADER_SIZE_LONG - PACKET_HEADER_SIZE);
+    }
+  else if (size < PACKET_HEADER_SIZE)
+    {
+      return false;
+    }
+
+  if (size > packet.get_buffer_size())
+    {
+      packet.resize(size);
+    }
+
+  client->packet_size = size;
+  return true;
+}
+
+
 void
 DistributionSocketLink::socket_connected(ISocket *con, void *data)
 {
@@ -2323,6 +3274,14 @@ DistributionSocketLink::socket_connected(ISocket *con, void *data)
   client->outbound = true;
   client->socket = con;
 
+  // Packets queued for an earlier connection are obsolete.
+  clear_outbound(client);
+
+  // The framing is negotiated again.
+  client->packet.clear();
+  client->packet_size = 0;
+  client->long_framing = false;
+
   TRACE_EXIT();
 }
 
@@ -2360,6 +3319,25 @@ DistributionSocketLink::socket_closed(ISocket *con, void *data)
 }
 
 
+//! The socket of the specified client can accept more data.
+void
+DistributionSocketLink::socket_writable(ISocket *con, void *data)
+{
+  TRACE_ENTER("DistributionSocketLink::socket_writable");
+  (void) con;
+
+  Client *client = (Client *)data;
+  assert(client != NULL);
+
+  if (is_client_valid(client) && client->socket != NULL)
+    {
+      flush_outbound(client);
+    }
+
+  TRACE_EXIT();
+}
+
+
 //! Read the configuration from the configurator.
 void
 DistributionSocketLink::read_configuration()
@@ -2386,6 +3364,9 @@ DistributionSocketLink::read_configuration()
   reconnect_interval = dist_manager->get_reconnect_interval();
   reconnect_attempts = dist_manager->get_reconnect_attempts();
 
+  discovery_enabled = dist_manager->get_discovery();
+  update_discovery();
+
   string str;
   str = dist_manager->get_username();
   username = str != "" ? g_strdup(str.c_str()) : NULL;
@@ -21,6 +21,7 @@
 
 #include <list>
 #include <map>
+#include <set>
 
 #if TIME_WITH_SYS_TIME
 # include <sys/time.h>
@@ -34,6 +35,7 @@
 #endif
 
 #include "DistributionLink.hh"
+#include "DistributionMetrics.hh"
 #include "IDistributionClientMessage.hh"
 #include "IConfiguratorListener.hh"
 #include "PacketBuffer.hh"
@@ -44,6 +46,16 @@
 #define DEFAULT_PORT (27273)
 #define DEFAULT_INTERVAL (15)
 #define DEFAULT_ATTEMPTS (5)
+#define FULL_STATE_INTERVAL (10)
+#define PACKET_HEADER_SIZE (4)
+#define PACKET_HEADER_SIZE_LONG (8)
+#define MAX_PACKET_SIZE (16 * 1024 * 1024)
+#define MAX_OUTBOUND_SIZE (MAX_PACKET_SIZE + 256 * 1024)
+#define DISCOVERY_GROUP "239.255.27.27"
+#define DISCOVERY_PORT (27273)
+#define DISCOVERY_INTERVAL (10)
+#define DISCOVERY_MAGIC (0x57524453)
+#define DISCOVERY_VERSION (1)
 
 class Configurator;
 
@@ -51,7 +63,8 @@ class DistributionSocketLink :
   public DistributionLink,
   public IConfiguratorListener,
   public ISocketServerListener,
-  public ISocketListener
+  public ISocketListener,
+  public IMulticastSocketListener
 {
 public:
 private:
@@ -73,6 +86,18 @@ private:
     PACKETFLAG_DEST     = 0x0002,
   };
 
+  //! Packet framing that a client can receive.
+  /*!
+   *  Short framing starts each packet with a 16-bit length. Long framing
+   *  sets that length to 0 and adds a 32-bit length after the version and
+   *  flags. Long framing is only used for packets that do not fit in a
+   *  short frame.
+   */
+  enum PacketFraming {
+    FRAMING_SHORT       = 0,
+    FRAMING_LONG        = 1,
+  };
+
   enum ClientListFlags
     {
       CLIENTLIST_ME     = 1,
@@ -84,13 +109,22 @@ private:
     IDistributionClientMessage *listener;
     DistributionClientMessageType type;
 
+    //! Last state sent for this client message.
+    std::string state;
+
+    //! Incremented each time the state changes.
+    int version;
+
     ClientMessageListener() :
       listener(NULL),
-      type(DCMT_PASSIVE)
+      type(DCMT_PASSIVE),
+      version(0)
     {
     }
   };
 
+  typedef std::map<DistributionClientMessageID, int> StateVersions;
+
   enum ClientType
     {
       CLIENTTYPE_UNKNOWN    = 1,
@@ -99,6 +133,16 @@ private:
       CLIENTTYPE_SIGNEDOFF  = 4,
     };
 
+  //! A packet that is waiting to be sent to a client.
+  struct OutboundPacket
+  {
+    //! Data that has not been sent yet.
+    std::string data;
+
+    //! Identifies a state message that can be replaced by a newer one. Empty otherwise.
+    std::string key;
+  };
+
   struct Client
   {
     Client() :
@@ -115,7 +159,11 @@ private:
       next_claim_time(0),
       reject_count(0),
       claim_count(0),
-      outbound(false)
+      outbound(false),
+      outbound_size(0),
+      outbound_overflow(false),
+      packet_size(0),
+      long_framing(false)
     {
     }
 
@@ -179,8 +227,45 @@ private:
 
     //! Is this an outbound connection
     bool outbound;
+
+    //! Packets that could not be written to the socket yet.
+    std::list<OutboundPacket> outbound_queue;
+
+    //! Number of bytes in the outbound queue.
+    int outbound_size;
+
+    //! The outbound queue is full and a packet was lost; nothing is written anymore.
+    bool outbound_overflow;
+
+    //! Version of each client message state last sent to this client.
+    StateVersions state_versions;
+
+    //! Size of the packet being received without the long length, or 0 if not known yet.
+    int packet_size;
+
+    //! Whether the client can receive packets with long framing.
+    bool long_framing;
+  };
+
+  //! A peer that announced itself on the local network.
+  struct DiscoveredPeer
+  {
+    DiscoveredPeer() : port(0), connect_heartbeat(0)
+    {
+    }
+
+    //! Address of the peer.
+    std::string host;
+
+    //! Port on which the peer listens.
+    int port;
+
+    //! Heartbeat at which to connect to the peer.
+    int connect_heartbeat;
   };
 
+  typedef std::map<std::string, DiscoveredPeer> DiscoveredPeers;
+
 
 public:
   DistributionSocketLink(Configurator *conf);
@@ -189,6 +274,10 @@ public:
   void init_my_id();
   std::string get_my_id() const;
   int get_number_of_peers();
+  map<string, int> get_peer_queue_sizes();
+  void get_packet_counts(int &packets_sent, int &packets_received,
+                         int &bytes_sent, int &bytes_received);
+  void get_message_metrics(DistributionMessageMetricsList &metrics);
   void set_distribution_manager(DistributionManager *dll);
   void init();
   void heartbeat();
@@ -206,14 +295,23 @@ public:
                                IDistributionClientMessage *callback);
   bool unregister_client_message(DistributionClientMessageID id);
   bool broadcast_client_message(DistributionClientMessageID id, PacketBuffer &buffer);
+  bool unicast_client_message(DistributionClientMessageID id, const std::string &client_id,
+                              PacketBuffer &buffer);
 
   void socket_accepted(ISocketServer *server, ISocket *con);
   void socket_connected(ISocket *con, void *data);
   void socket_io(ISocket *con, void *data);
+  void socket_writable(ISocket *con, void *data);
   void socket_closed(ISocket *con, void *data);
 
+  void multicast_received(IMulticastSocket *socket, const std::string &host, const void *buf, int count);
+
 private:
   bool is_client_valid(Client *client);
+  void insert_client(Client *client);
+  void unindex_client(Client *client);
+  void index_client_id(Client *client);
+  void unindex_client_id(Client *client);
   bool add_client(gchar *id, gchar *host, gint port, ClientType type, Client *peer = NULL);
   void remove_client(Client *client);
   void remove_peer_clients(Client *client);
@@ -222,6 +320,7 @@ private:
   Client *find_client_by_id(gchar *id);
   bool client_is_me(gchar *id);
   bool exists_client(gchar *id);
+  bool is_client_reachable(gchar *id, const std::string &host, gint port);
 
   bool set_client_id(Client *client, gchar *id);
 
@@ -231,12 +330,24 @@ private:
   void set_me_master();
 
   void init_packet(PacketBuffer &packet, PacketCommand cmd);
+  void init_client_message_packet(PacketBuffer &packet, DistributionClientMessageID id, PacketBuffer &buffer);
   void send_packet_broadcast(PacketBuffer &packet);
-  void send_packet_except(PacketBuffer &packet, Client *client);
-  void send_packet(Client *client, PacketBuffer &packet);
+  void send_packet_except(PacketBuffer &packet, Client *client, Client *source = NULL);
+  void send_packet(Client *client, PacketBuffer &packet, Client *source = NULL);
+  void send_packet_addressed(Client *client, PacketBuffer &packet);
+  Client *get_connection(Client *client) const;
   void forward_packet_except(PacketBuffer &packet, Client *client, Client *source);
   void forward_packet(PacketBuffer &packet, Client *dest, Client *source);
-
+  void write_packet(Client *client, PacketBuffer &packet, const gchar *source_id, const gchar *dest_id);
+  void record_sent_packet(const guint8 *data, int size, int wire_size);
+  void queue_packet(Client *client, const SocketVector *vec, int count, int bytes_written);
+  void flush_outbound(Client *client);
+  void clear_outbound(Client *client);
+  void forget_delivered_state(Client *client);
+  std::string get_state_key(const std::string &data) const;
+  static const char *get_command_name(int cmd);
+
+  bool read_packet_size(Client *client);
   void process_client_packet(Client *client);
   void handle_hello1(PacketBuffer &packet, Client *client);
   void handle_hello2(PacketBuffer &packet, Client *client);
@@ -258,10 +369,15 @@ private:
   void send_claim(Client *client);
   void send_new_master(Client *client = NULL);
   void send_claim_reject(Client *client);
-  void send_client_message(DistributionClientMessageType type);
+  void send_client_message(DistributionClientMessageType type, bool delta = false);
+  int pack_client_messages(PacketBuffer &packet, DistributionClientMessageType type, Client *client);
 
   bool start_async_server();
 
+  void update_discovery();
+  void send_announcement();
+  void connect_discovered_peers();
+
   void read_configuration();
   void config_changed_notify(const string &key);
 
@@ -290,6 +406,12 @@ private:
   //! All clients.
   list<Client *> clients;
 
+  //! All clients, for fast validity checks.
+  std::set<Client *> client_set;
+
+  //! Clients indexed by id.
+  std::map<std::string, Client *> client_ids;
+
   //! Active client
   Client *master_client;
 
@@ -311,6 +433,18 @@ private:
   //! The server socket.
   ISocketServer *server_socket;
 
+  //! Socket on which peers announce themselves.
+  IMulticastSocket *discovery_socket;
+
+  //! Whether peers are discovered on the local network.
+  bool discovery_enabled;
+
+  //! Whether to announce myself at the next heartbeat.
+  bool discovery_announce;
+
+  //! Announced peers that I will connect to, indexed by id.
+  DiscoveredPeers discovered_peers;
+
   //! Whether distribution is enabled.
   bool network_enabled;
   bool server_enabled;
@@ -326,6 +460,9 @@ private:
 
   //!
   int heartbeat_count;
+
+  //! Traffic and handling time per packet and client message.
+  DistributionMetrics metrics;
 };
 
 #endif // DISTRIBUTIONSOCKETLINK_HH
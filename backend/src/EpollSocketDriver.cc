@@ -0,0 +1,759 @@
+// EpollSocketDriver.cc --- Socket driver based on epoll
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_DISTRIBUTION)
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "debug.hh"
+#include "EpollSocketDriver.hh"
+
+using namespace std;
+
+//! Maximum number of events handled per epoll_wait call.
+#define MAX_EVENTS (64)
+
+//! Maximum number of segments written at once.
+#define MAX_VECTORS (8)
+
+
+//! Creates a new listen socket.
+EpollSocketServer::EpollSocketServer(EpollSocketDriver *driver) :
+  driver(driver),
+  fd(-1)
+{
+}
+
+
+//! Destructs the listen socket.
+EpollSocketServer::~EpollSocketServer()
+{
+  if (fd != -1)
+    {
+      driver->remove(fd);
+      ::close(fd);
+      fd = -1;
+    }
+}
+
+
+//! Listen at the specified port.
+void
+EpollSocketServer::listen(int port)
+{
+  TRACE_ENTER_MSG("EpollSocketServer::listen", port);
+
+  // Prefer a dual stack socket; fall back to IPv4 only.
+  fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd != -1)
+    {
+      int v6only = 0;
+      setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+
+      struct sockaddr_in6 addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin6_family = AF_INET6;
+      addr.sin6_addr = in6addr_any;
+      addr.sin6_port = htons(port);
+
+      int reuse = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+      if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+          ::close(fd);
+          fd = -1;
+        }
+    }
+
+  if (fd == -1)
+    {
+      fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd == -1)
+        {
+          throw SocketException(string("Failed to create server: ") + strerror(errno));
+        }
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(port);
+
+      int reuse = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+      if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+          string msg = strerror(errno);
+          ::close(fd);
+          fd = -1;
+          throw SocketException(string("Failed to listen: ") + msg);
+        }
+    }
+
+  if (::listen(fd, SOMAXCONN) == -1)
+    {
+      string msg = strerror(errno);
+      ::close(fd);
+      fd = -1;
+      throw SocketException(string("Failed to listen: ") + msg);
+    }
+
+  // Level-triggered, so that connections left in the backlog after a
+  // failed accept (e.g. EMFILE) are reported again.
+  driver->add(fd, EPOLLIN, this);
+  TRACE_EXIT();
+}
+
+
+//! Accepts all pending connections.
+void
+EpollSocketServer::handle_events(guint32 events)
+{
+  TRACE_ENTER_MSG("EpollSocketServer::handle_events", events);
+  (void) events;
+
+  while (fd != -1)
+    {
+      int con_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (con_fd == -1)
+        {
+          if (errno == EINTR || errno == ECONNABORTED)
+            {
+              continue;
+            }
+
+          // EAGAIN: the backlog is drained. Anything else is retried
+          // at the next dispatch.
+          TRACE_MSG("accept: " << strerror(errno));
+          break;
+        }
+
+      EpollSocket *socket = new EpollSocket(driver, con_fd);
+      if (listener != NULL)
+        {
+          listener->socket_accepted(this, socket);
+        }
+      else
+        {
+          delete socket;
+        }
+    }
+  TRACE_EXIT();
+}
+
+
+//! Creates a new socket.
+EpollSocket::EpollSocket(EpollSocketDriver *driver) :
+  driver(driver),
+  fd(-1),
+  connecting(false),
+  notify_writable(false),
+  destroyed(NULL)
+{
+}
+
+
+//! Creates a new socket for an accepted connection.
+EpollSocket::EpollSocket(EpollSocketDriver *driver, int fd) :
+  driver(driver),
+  fd(fd),
+  connecting(false),
+  notify_writable(false),
+  destroyed(NULL)
+{
+  int keepalive = 1;
+  setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
+
+  driver->add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, this);
+}
+
+
+//! Destructs the socket.
+EpollSocket::~EpollSocket()
+{
+  TRACE_ENTER("EpollSocket::~EpollSocket");
+  if (destroyed != NULL)
+    {
+      *destroyed = true;
+    }
+  close();
+  TRACE_EXIT();
+}
+
+
+//! Connects to the specified host.
+/*!
+ *  The host name is resolved synchronously. The connection itself is
+ *  established asynchronously and reported with socket_connected.
+ */
+void
+EpollSocket::connect(const string &host, int port)
+{
+  TRACE_ENTER_MSG("EpollSocket::connect", host << " " << port);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+
+  struct addrinfo *addresses = NULL;
+  int rc = getaddrinfo(host.c_str(), service, &hints, &addresses);
+  if (rc != 0)
+    {
+      TRACE_MSG("failed to resolve: " << gai_strerror(rc));
+      TRACE_EXIT();
+      return;
+    }
+
+  for (struct addrinfo *a = addresses; a != NULL && fd == -1; a = a->ai_next)
+    {
+      fd = socket(a->ai_family, a->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, a->ai_protocol);
+      if (fd == -1)
+        {
+          continue;
+        }
+
+      int keepalive = 1;
+      setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
+
+      if (::connect(fd, a->ai_addr, a->ai_addrlen) == -1 && errno != EINPROGRESS)
+        {
+          TRACE_MSG("failed to connect: " << strerror(errno));
+          ::close(fd);
+          fd = -1;
+        }
+    }
+  freeaddrinfo(addresses);
+
+  if (fd != -1)
+    {
+      // Completion, also of an immediate connect, is reported by the
+      // first EPOLLOUT edge.
+      connecting = true;
+      driver->add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, this);
+    }
+  TRACE_EXIT();
+}
+
+
+//! Read from the connection.
+void
+EpollSocket::read(void *buf, int count, int &bytes_read)
+{
+  TRACE_ENTER_MSG("EpollSocket::read", count);
+  bytes_read = 0;
+
+  if (fd != -1)
+    {
+      ssize_t num_read;
+      do
+        {
+          num_read = recv(fd, buf, count, 0);
+        }
+      while (num_read == -1 && errno == EINTR);
+
+      if (num_read == -1)
+        {
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+              throw SocketException(string("socket read error: ") + strerror(errno));
+            }
+        }
+      else
+        {
+          bytes_read = (int)num_read;
+        }
+    }
+  TRACE_RETURN(bytes_read);
+}
+
+
+//! Write to the connection.
+void
+EpollSocket::write(void *buf, int count, int &bytes_written)
+{
+  TRACE_ENTER_MSG("EpollSocket::write", count);
+  bytes_written = 0;
+
+  if (fd != -1 && !connecting)
+    {
+      ssize_t num_written;
+      do
+        {
+          num_written = send(fd, buf, count, MSG_NOSIGNAL);
+        }
+      while (num_written == -1 && errno == EINTR);
+
+      if (num_written == -1)
+        {
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+              throw SocketException(string("socket write error: ") + strerror(errno));
+            }
+        }
+      else
+        {
+          bytes_written = (int)num_written;
+        }
+    }
+  TRACE_RETURN(bytes_written);
+}
+
+
+//! Write several segments to the connection with a single system call.
+void
+EpollSocket::write_vector(const SocketVector *vec, int count, int &bytes_written)
+{
+  TRACE_ENTER_MSG("EpollSocket::write_vector", count);
+  if (count > MAX_VECTORS)
+    {
+      ISocket::write_vector(vec, count, bytes_written);
+      TRACE_RETURN(bytes_written);
+      return;
+    }
+
+  bytes_written = 0;
+  if (fd != -1 && !connecting)
+    {
+      struct iovec iov[MAX_VECTORS];
+      for (int i = 0; i < count; i++)
+        {
+          iov[i].iov_base = (void *)vec[i].buf;
+          iov[i].iov_len = vec[i].count;
+        }
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = count;
+
+      ssize_t num_written;
+      do
+        {
+          num_written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+      while (num_written == -1 && errno == EINTR);
+
+      if (num_written == -1)
+        {
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+              throw SocketException(string("socket write error: ") + strerror(errno));
+            }
+        }
+      else
+        {
+          bytes_written = (int)num_written;
+        }
+    }
+  TRACE_RETURN(bytes_written);
+}
+
+
+//! Enables or disables notifications when the connection accepts more data.
+void
+EpollSocket::set_notify_writable(bool enabled)
+{
+  notify_writable = enabled;
+}
+
+
+//! Close the connection.
+void
+EpollSocket::close()
+{
+  TRACE_ENTER("EpollSocket::close");
+  if (fd != -1)
+    {
+      driver->remove(fd);
+      shutdown(fd, SHUT_RDWR);
+      ::close(fd);
+      fd = -1;
+    }
+  connecting = false;
+  TRACE_EXIT();
+}
+
+
+//! Returns whether a read would not block.
+/*!
+ *  The listener treats an empty read as a closed connection, so it is only
+ *  notified while data or end-of-file is pending.
+ */
+bool
+EpollSocket::has_input()
+{
+  char c;
+  ssize_t rc;
+  do
+    {
+      rc = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  return rc != -1 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+
+//! Handles the events of the connection.
+void
+EpollSocket::handle_events(guint32 events)
+{
+  TRACE_ENTER_MSG("EpollSocket::handle_events", events);
+
+  // The listener may delete this socket from any callback.
+  bool deleted = false;
+  destroyed = &deleted;
+
+  if (connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+    {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1)
+        {
+          error = errno;
+        }
+
+      connecting = false;
+      if (error != 0)
+        {
+          TRACE_MSG("failed to connect: " << strerror(error));
+          close();
+          if (listener != NULL)
+            {
+              listener->socket_closed(this, user_data);
+            }
+        }
+      else if (listener != NULL)
+        {
+          listener->socket_connected(this, user_data);
+        }
+    }
+
+  if (!deleted && (events & (EPOLLIN | EPOLLRDHUP)))
+    {
+      // Edge-triggered: keep reading until the input is drained.
+      while (!deleted && fd != -1 && listener != NULL && has_input())
+        {
+          listener->socket_io(this, user_data);
+        }
+    }
+
+  if (!deleted && fd != -1 && !connecting && (events & EPOLLOUT) && notify_writable && listener != NULL)
+    {
+      listener->socket_writable(this, user_data);
+    }
+
+  if (!deleted && fd != -1 && (events & (EPOLLERR | EPOLLHUP)))
+    {
+      driver->remove(fd);
+      if (listener != NULL)
+        {
+          listener->socket_closed(this, user_data);
+        }
+    }
+
+  if (!deleted)
+    {
+      destroyed = NULL;
+    }
+  TRACE_EXIT();
+}
+
+
+//! Creates a new multicast socket.
+EpollMulticastSocket::EpollMulticastSocket(EpollSocketDriver *driver) :
+  driver(driver),
+  fd(-1)
+{
+  memset(&group_address, 0, sizeof(group_address));
+}
+
+
+//! Destructs the multicast socket.
+EpollMulticastSocket::~EpollMulticastSocket()
+{
+  if (fd != -1)
+    {
+      driver->remove(fd);
+      ::close(fd);
+      fd = -1;
+    }
+}
+
+
+//! Join the multicast group at the specified port.
+void
+EpollMulticastSocket::join(const string &group, int port)
+{
+  TRACE_ENTER_MSG("EpollMulticastSocket::join", group << " " << port);
+
+  group_address.sin_family = AF_INET;
+  group_address.sin_port = htons(port);
+  if (inet_pton(AF_INET, group.c_str(), &group_address.sin_addr) != 1)
+    {
+      throw SocketException("Invalid multicast group: " + group);
+    }
+
+  fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    {
+      throw SocketException(string("Failed to create multicast socket: ") + strerror(errno));
+    }
+
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+
+  struct ip_mreq mreq;
+  memset(&mreq, 0, sizeof(mreq));
+  mreq.imr_multiaddr = group_address.sin_addr;
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+    {
+      string msg = strerror(errno);
+      ::close(fd);
+      fd = -1;
+      throw SocketException("Failed to join multicast group: " + msg);
+    }
+
+  unsigned char loop = 1;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+  unsigned char ttl = 1;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+  driver->add(fd, EPOLLIN | EPOLLET, this);
+  TRACE_EXIT();
+}
+
+
+//! Send a datagram to the group.
+void
+EpollMulticastSocket::send(const void *buf, int count)
+{
+  if (fd != -1 &&
+      sendto(fd, buf, count, MSG_NOSIGNAL, (struct sockaddr *)&group_address, sizeof(group_address)) == -1 &&
+      errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+      throw SocketException(string("socket write error: ") + strerror(errno));
+    }
+}
+
+
+//! Receives all pending datagrams.
+void
+EpollMulticastSocket::handle_events(guint32 events)
+{
+  TRACE_ENTER_MSG("EpollMulticastSocket::handle_events", events);
+  (void) events;
+
+  while (fd != -1)
+    {
+      char buf[1500];
+      struct sockaddr_in from;
+      socklen_t from_len = sizeof(from);
+
+      ssize_t num_read = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+      if (num_read == -1)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          break;
+        }
+
+      char host[INET_ADDRSTRLEN];
+      if (listener != NULL && inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host)) != NULL)
+        {
+          listener->multicast_received(this, host, buf, (int)num_read);
+        }
+    }
+  TRACE_EXIT();
+}
+
+
+//! Creates the epoll instance.
+EpollSocketDriver::EpollSocketDriver() :
+  epoll_fd(-1),
+  channel(NULL),
+  watch(0),
+  next_serial(0)
+{
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1)
+    {
+      throw SocketException(string("Failed to create epoll instance: ") + strerror(errno));
+    }
+
+  channel = g_io_channel_unix_new(epoll_fd);
+  watch = g_io_add_watch(channel, G_IO_IN, static_epoll_callback, this);
+}
+
+
+//! Destructs the epoll instance.
+EpollSocketDriver::~EpollSocketDriver()
+{
+  if (watch != 0)
+    {
+      g_source_remove(watch);
+    }
+
+  if (channel != NULL)
+    {
+      g_io_channel_unref(channel);
+    }
+
+  if (epoll_fd != -1)
+    {
+      ::close(epoll_fd);
+    }
+}
+
+
+//! Creates a new socket.
+ISocket *
+EpollSocketDriver::create_socket()
+{
+  return new EpollSocket(this);
+}
+
+
+//! Creates a new listen socket.
+ISocketServer *
+EpollSocketDriver::create_server()
+{
+  return new EpollSocketServer(this);
+}
+
+
+//! Creates a new multicast socket.
+IMulticastSocket *
+EpollSocketDriver::create_multicast_socket()
+{
+  return new EpollMulticastSocket(this);
+}
+
+
+//! Starts dispatching the events of a file descriptor to a handler.
+void
+EpollSocketDriver::add(int fd, guint32 events, IEpollHandler *handler)
+{
+  Registration registration;
+  registration.handler = handler;
+  registration.serial = next_serial++;
+
+  // The serial tells a new registration of a reused descriptor apart from
+  // an old one that still has events pending.
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.u64 = ((guint64)registration.serial << 32) | (guint32)fd;
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+      throw SocketException(string("Failed to watch socket: ") + strerror(errno));
+    }
+  handlers[fd] = registration;
+}
+
+
+//! Stops dispatching the events of a file descriptor.
+void
+EpollSocketDriver::remove(int fd)
+{
+  Handlers::iterator it = handlers.find(fd);
+  if (it != handlers.end())
+    {
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      handlers.erase(it);
+    }
+}
+
+
+gboolean
+EpollSocketDriver::static_epoll_callback(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  (void) source;
+  (void) condition;
+
+  EpollSocketDriver *driver = (EpollSocketDriver *)data;
+  driver->dispatch();
+  return TRUE;
+}
+
+
+//! Dispatches all pending events.
+void
+EpollSocketDriver::dispatch()
+{
+  TRACE_ENTER("EpollSocketDriver::dispatch");
+  struct epoll_event events[MAX_EVENTS];
+
+  int count;
+  do
+    {
+      count = epoll_wait(epoll_fd, events, MAX_EVENTS, 0);
+      for (int i = 0; i < count; i++)
+        {
+          int fd = (int)(guint32)(events[i].data.u64 & 0xffffffff);
+          guint32 serial = (guint32)(events[i].data.u64 >> 32);
+
+          // The handler of a later event may have been removed by an earlier one.
+          Handlers::iterator it = handlers.find(fd);
+          if (it != handlers.end() && it->second.serial == serial)
+            {
+              it->second.handler->handle_events(events[i].events);
+            }
+        }
+    }
+  while (count == MAX_EVENTS);
+
+  TRACE_EXIT();
+}
+
+#endif
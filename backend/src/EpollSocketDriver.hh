@@ -0,0 +1,198 @@
+// EpollSocketDriver.hh --- Socket driver based on epoll
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef EPOLLSOCKETDRIVER_HH
+#define EPOLLSOCKETDRIVER_HH
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_DISTRIBUTION)
+
+#include <map>
+
+#include <netinet/in.h>
+#include <glib.h>
+
+#include "SocketDriver.hh"
+
+using namespace workrave;
+
+class EpollSocketDriver;
+
+//! Receives the events of a file descriptor registered with the driver.
+class IEpollHandler
+{
+public:
+  virtual ~IEpollHandler() {}
+
+  //! The file descriptor has pending events.
+  virtual void handle_events(guint32 events) = 0;
+};
+
+
+//! Listen socket implementation using epoll
+class EpollSocketServer
+  : public ISocketServer,
+    public IEpollHandler
+{
+public:
+  EpollSocketServer(EpollSocketDriver *driver);
+  virtual ~EpollSocketServer();
+
+  // ISocketServer  interface
+  virtual void listen(int port);
+
+  // IEpollHandler interface
+  virtual void handle_events(guint32 events);
+
+private:
+  //! The driver that dispatches the events.
+  EpollSocketDriver *driver;
+
+  //! Listen socket.
+  int fd;
+};
+
+
+//! Socket implementation using epoll
+class EpollSocket
+  : public ISocket,
+    public IEpollHandler
+{
+public:
+  EpollSocket(EpollSocketDriver *driver);
+  EpollSocket(EpollSocketDriver *driver, int fd);
+  virtual ~EpollSocket();
+
+  // ISocket interface
+  virtual void connect(const std::string &hostname, int port);
+  virtual void read(void *buf, int count, int &bytes_read);
+  virtual void write(void *buf, int count, int &bytes_written);
+  virtual void write_vector(const SocketVector *vec, int count, int &bytes_written);
+  virtual void set_notify_writable(bool enabled);
+  virtual void close();
+
+  // IEpollHandler interface
+  virtual void handle_events(guint32 events);
+
+private:
+  bool has_input();
+
+private:
+  //! The driver that dispatches the events.
+  EpollSocketDriver *driver;
+
+  //! Connected socket.
+  int fd;
+
+  //! Is a connect in progress?
+  bool connecting;
+
+  //! Report that the socket accepts more data.
+  bool notify_writable;
+
+  //! Set to true if the socket is deleted while handling events.
+  bool *destroyed;
+};
+
+
+//! Multicast socket implementation using epoll
+class EpollMulticastSocket
+  : public IMulticastSocket,
+    public IEpollHandler
+{
+public:
+  EpollMulticastSocket(EpollSocketDriver *driver);
+  virtual ~EpollMulticastSocket();
+
+  // IMulticastSocket interface
+  virtual void join(const std::string &group, int port);
+  virtual void send(const void *buf, int count);
+
+  // IEpollHandler interface
+  virtual void handle_events(guint32 events);
+
+private:
+  //! The driver that dispatches the events.
+  EpollSocketDriver *driver;
+
+  //! Datagram socket.
+  int fd;
+
+  //! Address of the group.
+  struct sockaddr_in group_address;
+};
+
+
+//! Socket driver that waits for the events of all sockets with a single epoll instance.
+/*!
+ *  The epoll instance is watched by one main loop source. Connected
+ *  sockets are registered edge-triggered: the driver keeps notifying a
+ *  socket until its input is drained. Listen sockets are level-triggered
+ *  and accept all pending connections at once.
+ */
+class EpollSocketDriver
+  : public SocketDriver
+{
+public:
+  EpollSocketDriver();
+  virtual ~EpollSocketDriver();
+
+  //! Create a new socket
+  ISocket *create_socket();
+
+  //! Create a new listen socket
+  ISocketServer *create_server();
+
+  //! Create a new multicast socket
+  IMulticastSocket *create_multicast_socket();
+
+  void add(int fd, guint32 events, IEpollHandler *handler);
+  void remove(int fd);
+
+private:
+  //! A file descriptor registered with the epoll instance.
+  struct Registration
+  {
+    IEpollHandler *handler;
+    guint32 serial;
+  };
+
+  typedef std::map<int, Registration> Handlers;
+
+  static gboolean static_epoll_callback(GIOChannel *source, GIOCondition condition, gpointer data);
+  void dispatch();
+
+private:
+  //! The epoll instance.
+  int epoll_fd;
+
+  //! Main loop channel of the epoll instance.
+  GIOChannel *channel;
+
+  //! Main loop watch of the epoll instance.
+  guint watch;
+
+  //! Registered handlers, indexed by file descriptor.
+  Handlers handlers;
+
+  //! Serial of the next registration.
+  guint32 next_serial;
+};
+
+#endif
+#endif // EPOLLSOCKETDRIVER_HH
@@ -188,10 +188,38 @@ GIOSocket::static_data_callback(GSocket *socket,
   return ret;
 }
 
+gboolean
+GIOSocket::static_write_callback(GSocket *socket,
+                                 GIOCondition condition,
+                                 gpointer user_data)
+{
+  TRACE_ENTER_MSG("GIOSocket::static_write_callback", (int)condition);
+
+  GIOSocket *giosocket = (GIOSocket *)user_data;
+
+  (void) socket;
+
+  try
+    {
+      if (giosocket->listener != NULL)
+        {
+          giosocket->listener->socket_writable(giosocket, giosocket->user_data);
+        }
+    }
+  catch(...)
+    {
+      // Make sure that no exception reach the glib mainloop.
+      TRACE_MSG("Exception");
+    }
+  TRACE_EXIT();
+  return TRUE;
+}
+
 //! Creates a new connection.
 GIOSocket::GIOSocket(GSocketConnection *connection) :
   connection(connection),
-  resolver(NULL)
+  resolver(NULL),
+  write_source(NULL)
 {
   TRACE_ENTER("GIOSocket::GIOSocket(con)");
   socket = g_socket_connection_get_socket(connection);
@@ -214,6 +242,7 @@ GIOSocket::GIOSocket() :
   socket(NULL),
   resolver(NULL),
   source(NULL),
+  write_source(NULL),
   port(0)
 {
   TRACE_ENTER("GIOSocket::GIOSocket()");
@@ -237,6 +266,7 @@ GIOSocket::~GIOSocket()
     {
       g_source_destroy(source);
     }
+  set_notify_writable(false);
   TRACE_EXIT();
 }
 
@@ -342,22 +372,102 @@ GIOSocket::write(void *buf, int count, int &bytes_written)
   gsize num_written = 0;
   if (socket != NULL)
     {
-      num_written = g_socket_send(socket, (char *)buf, count, NULL, &error);
-      if (error != NULL)
+      gssize ret = g_socket_send(socket, (char *)buf, count, NULL, &error);
+      if (is_would_block(error))
+        {
+          ret = 0;
+        }
+      else if (error != NULL)
+        {
+          string msg = error->message;
+          g_error_free(error);
+          throw SocketException(string("socket write error: ") + msg);
+        }
+      num_written = (gsize) ret;
+    }
+  bytes_written = (int) num_written;
+}
+
+
+//! Write a sequence of segments to the connection using a single system call.
+void
+GIOSocket::write_vector(const SocketVector *vec, int count, int &bytes_written)
+{
+  const int max_vectors = 8;
+  if (count > max_vectors)
+    {
+      ISocket::write_vector(vec, count, bytes_written);
+      return;
+    }
+
+  GError *error = NULL;
+  gssize num_written = 0;
+  if (socket != NULL)
+    {
+      GOutputVector vectors[max_vectors];
+      for (int i = 0; i < count; i++)
+        {
+          vectors[i].buffer = vec[i].buf;
+          vectors[i].size = vec[i].count;
+        }
+
+      num_written = g_socket_send_message(socket, NULL, vectors, count, NULL, 0, 0, NULL, &error);
+
+      if (is_would_block(error))
+        {
+          num_written = 0;
+        }
+      else if (error != NULL)
         {
-          throw SocketException(string("socket write error: ") + error->message);
+          string msg = error->message;
+          g_error_free(error);
+          throw SocketException(string("socket write error: ") + msg);
         }
     }
   bytes_written = (int) num_written;
 }
 
 
+//! Enable/Disable notifications when the socket can accept more data.
+void
+GIOSocket::set_notify_writable(bool enabled)
+{
+  if (enabled && write_source == NULL && socket != NULL)
+    {
+      write_source = g_socket_create_source(socket, G_IO_OUT, NULL);
+      g_source_set_callback(write_source, (GSourceFunc) static_write_callback, (void*)this, NULL);
+      g_source_attach(write_source, NULL);
+    }
+  else if (!enabled && write_source != NULL)
+    {
+      g_source_destroy(write_source);
+      g_source_unref(write_source);
+      write_source = NULL;
+    }
+}
+
+
+//! Returns whether the error indicates that the operation would block.
+/*! The error is freed in that case. */
+bool
+GIOSocket::is_would_block(GError *error)
+{
+  if (error != NULL && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+    {
+      g_error_free(error);
+      return true;
+    }
+  return false;
+}
+
+
 //! Close the connection.
 void
 GIOSocket::close()
 {
   TRACE_ENTER("GIOSocket::close");
   GError *error = NULL;
+  set_notify_writable(false);
   if (socket != NULL)
     {
       g_socket_shutdown(socket, TRUE, TRUE, &error);
@@ -367,6 +477,171 @@ GIOSocket::close()
   TRACE_EXIT();
 }
 
+#if GLIB_CHECK_VERSION(2, 32, 0)
+
+//! Creates a new multicast socket.
+GIOMulticastSocket::GIOMulticastSocket() :
+  socket(NULL),
+  group_address(NULL),
+  source(NULL)
+{
+}
+
+
+//! Destructs the multicast socket.
+GIOMulticastSocket::~GIOMulticastSocket()
+{
+  if (source != NULL)
+    {
+      g_source_destroy(source);
+      g_source_unref(source);
+    }
+
+  if (socket != NULL)
+    {
+      g_socket_close(socket, NULL);
+      g_object_unref(socket);
+    }
+
+  if (group_address != NULL)
+    {
+      g_object_unref(group_address);
+    }
+}
+
+
+//! Join the multicast group at the specified port.
+void
+GIOMulticastSocket::join(const string &group, int port)
+{
+  TRACE_ENTER_MSG("GIOMulticastSocket::join", group << " " << port);
+  GError *error = NULL;
+
+  GInetAddress *group_inet_addr = g_inet_address_new_from_string(group.c_str());
+  if (group_inet_addr == NULL)
+    {
+      throw SocketException("Invalid multicast group: " + group);
+    }
+
+  socket = g_socket_new(g_inet_address_get_family(group_inet_addr),
+                        G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, &error);
+
+  if (socket != NULL)
+    {
+      GInetAddress *any = g_inet_address_new_any(g_inet_address_get_family(group_inet_addr));
+      GSocketAddress *bind_address = g_inet_socket_address_new(any, port);
+
+      g_socket_bind(socket, bind_address, TRUE, &error);
+
+      g_object_unref(bind_address);
+      g_object_unref(any);
+    }
+
+  if (error == NULL)
+    {
+      g_socket_join_multicast_group(socket, group_inet_addr, FALSE, NULL, &error);
+    }
+
+  if (error != NULL)
+    {
+      string msg = error->message;
+      g_error_free(error);
+      g_object_unref(group_inet_addr);
+
+      if (socket != NULL)
+        {
+          g_object_unref(socket);
+          socket = NULL;
+        }
+      throw SocketException("Failed to join multicast group: " + msg);
+    }
+
+  g_socket_set_blocking(socket, FALSE);
+  g_socket_set_multicast_loopback(socket, TRUE);
+  g_socket_set_multicast_ttl(socket, 1);
+
+  group_address = g_inet_socket_address_new(group_inet_addr, port);
+  g_object_unref(group_inet_addr);
+
+  source = g_socket_create_source(socket, G_IO_IN, NULL);
+  g_source_set_callback(source, (GSourceFunc) static_data_callback, (void*)this, NULL);
+  g_source_attach(source, NULL);
+  TRACE_EXIT();
+}
+
+
+//! Send a datagram to the group.
+void
+GIOMulticastSocket::send(const void *buf, int count)
+{
+  GError *error = NULL;
+
+  if (socket != NULL)
+    {
+      g_socket_send_to(socket, group_address, (const gchar *)buf, count, NULL, &error);
+      if (error != NULL)
+        {
+          string msg = error->message;
+          g_error_free(error);
+          throw SocketException("socket write error: " + msg);
+        }
+    }
+}
+
+
+gboolean
+GIOMulticastSocket::static_data_callback(GSocket *socket,
+                                         GIOCondition condition,
+                                         gpointer user_data)
+{
+  TRACE_ENTER_MSG("GIOMulticastSocket::static_data_callback", (int)condition);
+  GIOMulticastSocket *mcsocket = (GIOMulticastSocket *)user_data;
+
+  (void) condition;
+
+  while (true)
+    {
+      gchar buf[1500];
+      GSocketAddress *address = NULL;
+      GError *error = NULL;
+
+      gssize num_read = g_socket_receive_from(socket, &address, buf, sizeof(buf), NULL, &error);
+      if (error != NULL)
+        {
+          g_error_free(error);
+          break;
+        }
+
+      if (address != NULL)
+        {
+          GInetAddress *inet_addr = g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(address));
+          gchar *host = g_inet_address_to_string(inet_addr);
+
+          if (mcsocket->listener != NULL)
+            {
+              mcsocket->listener->multicast_received(mcsocket, host, buf, (int)num_read);
+            }
+
+          g_free(host);
+          g_object_unref(address);
+        }
+    }
+
+  TRACE_EXIT();
+  return TRUE;
+}
+
+
+//! Create a new multicast socket
+IMulticastSocket *
+GIOSocketDriver::create_multicast_socket()
+{
+  return new GIOMulticastSocket();
+}
+
+#endif
+
+
 //! Create a new socket
 ISocket *
 GIOSocketDriver::create_socket()
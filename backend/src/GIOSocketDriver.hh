@@ -65,6 +65,8 @@ public:
   virtual void connect(const std::string &hostname, int port);
   virtual void read(void *buf, int count, int &bytes_read);
   virtual void write(void *buf, int count, int &bytes_written);
+  virtual void write_vector(const SocketVector *vec, int count, int &bytes_written);
+  virtual void set_notify_writable(bool enabled);
   virtual void close();
 
 private:
@@ -80,15 +82,48 @@ private:
                                    GIOCondition condition,
                                    gpointer user_data);
 
+  static gboolean static_write_callback(GSocket *socket,
+                                        GIOCondition condition,
+                                        gpointer user_data);
+
+  static bool is_would_block(GError *error);
+
 private:
   GSocketConnection *connection;
   GSocket *socket;
   GResolver *resolver;
   GSource *source;
+  GSource *write_source;
   int port;
 };
 
 
+#if GLIB_CHECK_VERSION(2, 32, 0)
+//! Multicast socket implementation based on GIO
+class GIOMulticastSocket
+  : public IMulticastSocket
+{
+public:
+  GIOMulticastSocket();
+  virtual ~GIOMulticastSocket();
+
+  // IMulticastSocket interface
+  virtual void join(const std::string &group, int port);
+  virtual void send(const void *buf, int count);
+
+private:
+  static gboolean static_data_callback(GSocket *socket,
+                                       GIOCondition condition,
+                                       gpointer user_data);
+
+private:
+  GSocket *socket;
+  GSocketAddress *group_address;
+  GSource *source;
+};
+#endif
+
+
 class GIOSocketDriver
   : public SocketDriver
 {
@@ -97,6 +132,11 @@ class GIOSocketDriver
 
   //! Create a new listen socket
   ISocketServer *create_server();
+
+#if GLIB_CHECK_VERSION(2, 32, 0)
+  //! Create a new multicast socket
+  IMulticastSocket *create_multicast_socket();
+#endif
 };
 
 #endif
@@ -218,7 +218,8 @@ GNetSocket::static_async_connected(GTcpSocket *socket,
 
 //! Creates a new connection.
 GNetSocket::GNetSocket(GTcpSocket *socket) :
-  socket(socket)
+  socket(socket),
+  write_watch(0)
 {
   iochannel = gnet_tcp_socket_get_io_channel(socket);
   watch_flags = G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL;
@@ -231,7 +232,8 @@ GNetSocket::GNetSocket() :
   socket(NULL),
   iochannel(NULL),
   watch_flags(0),
-  watch(0)
+  watch(0),
+  write_watch(0)
 {
 }
 
@@ -249,6 +251,8 @@ GNetSocket::~GNetSocket()
     {
       g_source_remove(watch);
     }
+
+  set_notify_writable(false);
 }
 
 
@@ -293,7 +297,11 @@ GNetSocket::write(void *buf, int count, int &bytes_written)
   gsize num_written = 0;
   GIOError error = g_io_channel_write(iochannel, (char *)buf, (gsize)count, &num_written);
 
-  if (error != G_IO_ERROR_NONE)
+  if (error == G_IO_ERROR_AGAIN)
+    {
+      num_written = 0;
+    }
+  else if (error != G_IO_ERROR_NONE)
     {
       throw SocketException("write error");
     }
@@ -302,6 +310,48 @@ GNetSocket::write(void *buf, int count, int &bytes_written)
 }
 
 
+//! Enable/Disable notifications when the socket can accept more data.
+void
+GNetSocket::set_notify_writable(bool enabled)
+{
+  if (enabled && write_watch == 0 && iochannel != NULL)
+    {
+      write_watch = g_io_add_watch(iochannel, G_IO_OUT, static_async_writable, this);
+    }
+  else if (!enabled && write_watch != 0)
+    {
+      g_source_remove(write_watch);
+      write_watch = 0;
+    }
+}
+
+
+//! GNet reports that data can be written.
+gboolean
+GNetSocket::static_async_writable(GIOChannel *iochannel, GIOCondition condition,
+                                  gpointer data)
+{
+  GNetSocket *con =  (GNetSocket *)data;
+
+  (void) iochannel;
+  (void) condition;
+
+  try
+    {
+      if (con->listener != NULL)
+        {
+          con->listener->socket_writable(con, con->user_data);
+        }
+    }
+  catch(...)
+    {
+      // Make sure that no exception reach the glib mainloop.
+    }
+
+  return TRUE;
+}
+
+
 //! Close the connection.
 void
 GNetSocket::close()
@@ -328,6 +378,8 @@ GNetSocket::close()
 
   watch = 0;
   watch_flags = 0;
+
+  set_notify_writable(false);
 }
 
 //! Create a new socket
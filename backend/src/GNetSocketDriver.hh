@@ -71,6 +71,7 @@ public:
   virtual void connect(const std::string &hostname, int port);
   virtual void read(void *buf, int count, int &bytes_read);
   virtual void write(void *buf, int count, int &bytes_written);
+  virtual void set_notify_writable(bool enabled);
   virtual void close();
 
 private:
@@ -78,6 +79,7 @@ private:
   bool async_io(GIOChannel* iochannel, GIOCondition condition);
   void async_connected(GTcpSocket *socket, GInetAddr *ia, GTcpSocketConnectAsyncStatus status);
   static gboolean static_async_io(GIOChannel* iochannel, GIOCondition condition, gpointer data);
+  static gboolean static_async_writable(GIOChannel* iochannel, GIOCondition condition, gpointer data);
   static void static_async_connected(GTcpSocket *socket, GTcpSocketConnectAsyncStatus status, gpointer data);
 
 private:
@@ -92,6 +94,9 @@ private:
 
   //! Our watch ID
   guint watch;
+
+  //! Watch ID for writability
+  guint write_watch;
 };
 
 
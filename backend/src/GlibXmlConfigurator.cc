@@ -0,0 +1,407 @@
+// GlibXmlConfigurator.cc --- XML configuration backend without a DOM
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "debug.hh"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+#include "GlibXmlConfigurator.hh"
+
+using namespace std;
+
+//! Size of the chunks in which the file is read.
+static const int READ_CHUNK_SIZE = 16384;
+
+GlibXmlConfigurator::GlibXmlConfigurator()
+{
+}
+
+
+GlibXmlConfigurator::~GlibXmlConfigurator()
+{
+}
+
+
+//! Loads all keys from the specified file.
+bool
+GlibXmlConfigurator::load(string filename)
+{
+  TRACE_ENTER_MSG("GlibXmlConfigurator::load", filename);
+
+  last_filename = filename;
+  values.clear();
+  element_names.clear();
+
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL)
+    {
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  GMarkupParser parser;
+  memset(&parser, 0, sizeof(parser));
+  parser.start_element = static_start_element;
+  parser.end_element = static_end_element;
+
+  ParseState state;
+  state.configurator = this;
+
+  GMarkupParseContext *context = g_markup_parse_context_new(&parser, (GMarkupParseFlags) 0, &state, NULL);
+  GError *error = NULL;
+  bool ok = true;
+
+  char buffer[READ_CHUNK_SIZE];
+  size_t size;
+  while (ok && (size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+      ok = g_markup_parse_context_parse(context, buffer, size, &error);
+    }
+
+  ok = ok && !ferror(file) && g_markup_parse_context_end_parse(context, &error);
+
+  g_markup_parse_context_free(context);
+  fclose(file);
+
+  if (error != NULL)
+    {
+      TRACE_MSG("error: " << error->message);
+      g_error_free(error);
+    }
+
+  if (!ok)
+    {
+      values.clear();
+      element_names.clear();
+    }
+
+  TRACE_RETURN(ok << " " << values.size());
+  return ok;
+}
+
+
+//! Writes all keys to the specified file.
+bool
+GlibXmlConfigurator::save(string filename)
+{
+  TRACE_ENTER_MSG("GlibXmlConfigurator::save", filename);
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    {
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  fputs("<?xml version=\"1.0\"?>\n", file);
+  write_element(file, values.begin(), values.end(), "", "workrave", 0);
+
+  bool ok = !ferror(file);
+  ok = (fclose(file) == 0) && ok;
+
+  TRACE_RETURN(ok);
+  return ok;
+}
+
+
+bool
+GlibXmlConfigurator::save()
+{
+  return save(last_filename);
+}
+
+
+bool
+GlibXmlConfigurator::remove_key(const std::string &key)
+{
+  TRACE_ENTER_MSG("GlibXmlConfigurator::remove_key", key);
+  bool ret = values.erase(key) > 0;
+  TRACE_RETURN(ret);
+  return ret;
+}
+
+
+bool
+GlibXmlConfigurator::get_value(const std::string &key, VariantType type, Variant &out) const
+{
+  Values::const_iterator it = values.find(key);
+  if (it == values.end())
+    {
+      return false;
+    }
+
+  const Variant &value = it->second;
+  if (value.type == type)
+    {
+      out = value;
+      return true;
+    }
+
+  // Values read from the file are strings until they are set with a type.
+  string s = to_string(value);
+  bool ret = true;
+
+  out.type = type;
+  switch (type)
+    {
+    case VARIANT_TYPE_INT:
+      out.int_value = atoi(s.c_str());
+      break;
+
+    case VARIANT_TYPE_LONG:
+      out.long_value = atol(s.c_str());
+      break;
+
+    case VARIANT_TYPE_BOOL:
+      out.bool_value = (s == "true" || s == "yes" || s == "TRUE" || s == "1");
+      break;
+
+    case VARIANT_TYPE_DOUBLE:
+      out.double_value = g_ascii_strtod(s.c_str(), NULL);
+      break;
+
+    case VARIANT_TYPE_NONE:
+      out.type = VARIANT_TYPE_STRING;
+      // FALLTHROUGH
+
+    case VARIANT_TYPE_STRING:
+      out.string_value = s;
+      break;
+
+    default:
+      ret = false;
+    }
+
+  return ret;
+}
+
+
+bool
+GlibXmlConfigurator::set_value(const std::string &key, Variant &value)
+{
+  if (value.type == VARIANT_TYPE_NONE)
+    {
+      return false;
+    }
+
+  values[key] = value;
+  return true;
+}
+
+
+void
+GlibXmlConfigurator::static_start_element(GMarkupParseContext *context, const gchar *element_name,
+                                          const gchar **attribute_names, const gchar **attribute_values,
+                                          gpointer user_data, GError **error)
+{
+  (void) context;
+  (void) error;
+
+  ParseState *state = (ParseState *) user_data;
+  state->configurator->start_element(state, element_name, attribute_names, attribute_values);
+}
+
+
+void
+GlibXmlConfigurator::static_end_element(GMarkupParseContext *context, const gchar *element_name,
+                                        gpointer user_data, GError **error)
+{
+  (void) context;
+  (void) element_name;
+  (void) error;
+
+  ParseState *state = (ParseState *) user_data;
+  state->prefixes.pop_back();
+}
+
+
+//! Adds the attributes of an element as keys.
+void
+GlibXmlConfigurator::start_element(ParseState *state, const gchar *element_name,
+                                   const gchar **attribute_names, const gchar **attribute_values)
+{
+  string prefix;
+
+  // The root element is not part of the key path.
+  if (!state->prefixes.empty())
+    {
+      string name = element_name;
+      for (int i = 0; attribute_names[i] != NULL; i++)
+        {
+          if (strcmp(attribute_names[i], "id") == 0)
+            {
+              name = attribute_values[i];
+            }
+        }
+
+      string path = state->prefixes.back() + name;
+      if (name != element_name)
+        {
+          element_names[path] = element_name;
+        }
+      prefix = path + "/";
+    }
+
+  for (int i = 0; attribute_names[i] != NULL; i++)
+    {
+      values[prefix + attribute_names[i]] = Variant(string(attribute_values[i]));
+    }
+
+  state->prefixes.push_back(prefix);
+}
+
+
+//! Writes an element and all its descendants.
+/*!
+ *  \param begin first key below the element.
+ *  \param end key after the last key below the element.
+ *  \param path key path of the element, empty for the root element.
+ */
+void
+GlibXmlConfigurator::write_element(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                                   const string &path, const string &name, int depth) const
+{
+  string::size_type prefix_length = path.empty() ? 0 : path.length() + 1;
+  string indent(depth * 2, ' ');
+
+  fprintf(file, "%s<%s", indent.c_str(), name.c_str());
+  write_attributes(file, begin, end, prefix_length);
+
+  bool has_children = false;
+  for (Values::const_iterator i = begin; !has_children && i != end; i++)
+    {
+      has_children = i->first.find('/', prefix_length) != string::npos;
+    }
+
+  if (has_children)
+    {
+      fputs(">\n", file);
+      write_children(file, begin, end, prefix_length, depth + 1);
+      fprintf(file, "%s</%s>\n", indent.c_str(), name.c_str());
+    }
+  else
+    {
+      fputs("/>\n", file);
+    }
+}
+
+
+//! Writes the keys directly below an element as attributes.
+void
+GlibXmlConfigurator::write_attributes(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                                      string::size_type prefix_length) const
+{
+  for (Values::const_iterator i = begin; i != end; i++)
+    {
+      const string &key = i->first;
+      if (key.find('/', prefix_length) == string::npos)
+        {
+          gchar *escaped = g_markup_escape_text(to_string(i->second).c_str(), -1);
+          fprintf(file, " %s=\"%s\"", key.c_str() + prefix_length, escaped);
+          g_free(escaped);
+        }
+    }
+}
+
+
+//! Writes the child elements of an element.
+/*!
+ *  All keys below a child element share the prefix of the child and are
+ *  therefore adjacent in the sorted index.
+ */
+void
+GlibXmlConfigurator::write_children(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                                    string::size_type prefix_length, int depth) const
+{
+  Values::const_iterator i = begin;
+  while (i != end)
+    {
+      const string &key = i->first;
+      string::size_type pos = key.find('/', prefix_length);
+      if (pos == string::npos)
+        {
+          // Attribute of the parent.
+          i++;
+          continue;
+        }
+
+      string path = key.substr(0, pos);
+
+      Values::const_iterator child_end = i;
+      while (child_end != end
+             && child_end->first.compare(0, pos + 1, key, 0, pos + 1) == 0)
+        {
+          child_end++;
+        }
+
+      ElementNames::const_iterator name = element_names.find(path);
+      if (name != element_names.end())
+        {
+          write_element(file, i, child_end, path, name->second, depth);
+        }
+      else
+        {
+          write_element(file, i, child_end, path, path.substr(prefix_length), depth);
+        }
+
+      i = child_end;
+    }
+}
+
+
+//! Returns the textual representation of a value as stored in the file.
+string
+GlibXmlConfigurator::to_string(const Variant &value)
+{
+  stringstream ss;
+
+  switch (value.type)
+    {
+    case VARIANT_TYPE_INT:
+      ss << value.int_value;
+      break;
+
+    case VARIANT_TYPE_LONG:
+      ss << value.long_value;
+      break;
+
+    case VARIANT_TYPE_BOOL:
+      ss << (value.bool_value ? "1" : "0");
+      break;
+
+    case VARIANT_TYPE_DOUBLE:
+      ss << value.double_value;
+      break;
+
+    case VARIANT_TYPE_STRING:
+      return value.string_value;
+
+    case VARIANT_TYPE_NONE:
+    default:
+      break;
+    }
+
+  return ss.str();
+}
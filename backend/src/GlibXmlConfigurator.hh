@@ -0,0 +1,98 @@
+// GlibXmlConfigurator.hh --- XML configuration backend without a DOM
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef GLIBXMLCONFIGURATOR_HH
+#define GLIBXMLCONFIGURATOR_HH
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <glib.h>
+
+#include "IConfigBackend.hh"
+
+//! XML configuration backend that reads and writes config.xml without a DOM.
+/*!
+ *  The file is parsed once with a streaming parser into a flat index of
+ *  keys. Each XML attribute is a key; its path consists of the ids (or
+ *  names) of the enclosing elements, excluding the root element. Saving
+ *  writes the nested elements directly from the sorted index, in which
+ *  all keys of an element are adjacent.
+ */
+class GlibXmlConfigurator :
+  public virtual IConfigBackend
+{
+public:
+  GlibXmlConfigurator();
+  virtual ~GlibXmlConfigurator();
+
+  virtual bool load(std::string filename);
+  virtual bool save(std::string filename);
+  virtual bool save();
+
+  virtual bool remove_key(const std::string &key);
+  virtual bool get_value(const std::string &key, VariantType type, Variant &value) const;
+  virtual bool set_value(const std::string &key, Variant &value);
+
+private:
+  typedef std::map<std::string, Variant> Values;
+  typedef std::map<std::string, std::string> ElementNames;
+
+  //! State of the parser while loading.
+  struct ParseState
+  {
+    //! The configurator that is loaded.
+    GlibXmlConfigurator *configurator;
+
+    //! Key prefix of each open element.
+    std::vector<std::string> prefixes;
+  };
+
+  static void static_start_element(GMarkupParseContext *context, const gchar *element_name,
+                                   const gchar **attribute_names, const gchar **attribute_values,
+                                   gpointer user_data, GError **error);
+  static void static_end_element(GMarkupParseContext *context, const gchar *element_name,
+                                 gpointer user_data, GError **error);
+
+  void start_element(ParseState *state, const gchar *element_name,
+                     const gchar **attribute_names, const gchar **attribute_values);
+
+  void write_element(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                     const std::string &path, const std::string &name, int depth) const;
+  void write_attributes(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                        std::string::size_type prefix_length) const;
+  void write_children(FILE *file, Values::const_iterator begin, Values::const_iterator end,
+                      std::string::size_type prefix_length, int depth) const;
+
+  static std::string to_string(const Variant &value);
+
+private:
+  //! All values, indexed by key.
+  Values values;
+
+  //! XML element names that differ from the id used in the key path.
+  ElementNames element_names;
+
+  //! File name of the last load.
+  std::string last_filename;
+};
+
+#endif // GLIBXMLCONFIGURATOR_HH
@@ -0,0 +1,534 @@
+// HistoryStore.cc --- Binary storage of the statistics history
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.hh"
+
+#include "HistoryStore.hh"
+
+using namespace std;
+
+static const char HISTORY_MAGIC[8] = { 'W', 'R', 'H', 'I', 'S', 'T', 0, 0 };
+static const guint32 HISTORY_VERSION = 1;
+static const guint32 HISTORY_HEADER_SIZE = 64;
+
+// Offsets in the header.
+static const int HEADER_VERSION = 8;
+static const int HEADER_HEADER_SIZE = 12;
+static const int HEADER_RECORD_SIZE = 16;
+static const int HEADER_BREAK_COUNT = 20;
+static const int HEADER_BREAK_VALUE_COUNT = 24;
+static const int HEADER_VALUE_COUNT = 28;
+static const int HEADER_FIRST_DAY = 32;
+static const int HEADER_DAY_COUNT = 36;
+static const int HEADER_SOURCE_SIZE = 40;
+
+// Offsets in a record.
+static const int RECORD_FLAGS = 0;
+static const int RECORD_START = 4;
+static const int RECORD_STOP = 24;
+static const int RECORD_BREAK_STATS = 44;
+
+static const guint32 RECORD_FLAG_PRESENT = 1;
+
+static inline void
+put_uint32(guint8 *data, guint32 value)
+{
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static inline guint32
+get_uint32(const guint8 *data)
+{
+  return ((guint32)data[0]) | ((guint32)data[1] << 8) | ((guint32)data[2] << 16) | ((guint32)data[3] << 24);
+}
+
+static inline void
+put_int64(guint8 *data, gint64 value)
+{
+  put_uint32(data, (guint32)(value & 0xffffffff));
+  put_uint32(data + 4, (guint32)(((guint64)value) >> 32));
+}
+
+static inline gint64
+get_int64(const guint8 *data)
+{
+  return (gint64)(((guint64)get_uint32(data + 4) << 32) | get_uint32(data));
+}
+
+static inline void
+put_date(guint8 *data, const struct tm &date)
+{
+  put_uint32(data, date.tm_mday);
+  put_uint32(data + 4, date.tm_mon);
+  put_uint32(data + 8, date.tm_year);
+  put_uint32(data + 12, date.tm_hour);
+  put_uint32(data + 16, date.tm_min);
+}
+
+static inline void
+get_date(const guint8 *data, struct tm &date)
+{
+  date.tm_mday = (gint32)get_uint32(data);
+  date.tm_mon = (gint32)get_uint32(data + 4);
+  date.tm_year = (gint32)get_uint32(data + 8);
+  date.tm_hour = (gint32)get_uint32(data + 12);
+  date.tm_min = (gint32)get_uint32(data + 16);
+}
+
+
+//! Constructor
+HistoryStore::HistoryStore()
+  : mapped_file(NULL)
+{
+  init_header(header);
+}
+
+
+//! Destructor
+HistoryStore::~HistoryStore()
+{
+  close();
+}
+
+
+//! Sets the name of the history file.
+void
+HistoryStore::init(const string &filename)
+{
+  close();
+  this->filename = filename;
+}
+
+
+//! Maps the history file into memory.
+/*!
+ *  \param source_size current size of the text history. The file is
+ *         rejected when the text history was modified after the file was
+ *         last written, e.g. by an older version. A negative size means
+ *         that there is no text history and disables the check.
+ *
+ *  \retval true the file is valid and mapped.
+ */
+bool
+HistoryStore::open(gint64 source_size)
+{
+  TRACE_ENTER_MSG("HistoryStore::open", filename);
+
+  close();
+
+  mapped_file = g_mapped_file_new(filename.c_str(), FALSE, NULL);
+
+  bool ok = (mapped_file != NULL);
+  if (ok)
+    {
+      const guint8 *data = (const guint8 *) g_mapped_file_get_contents(mapped_file);
+      gsize size = g_mapped_file_get_length(mapped_file);
+
+      ok = unpack_header(data, size, header) && (source_size < 0 || header.source_size == source_size);
+      TRACE_MSG("days = " << header.day_count << " valid = " << ok);
+    }
+
+  if (!ok)
+    {
+      close();
+    }
+
+  TRACE_EXIT();
+  return ok;
+}
+
+
+//! Unmaps the history file.
+void
+HistoryStore::close()
+{
+  if (mapped_file != NULL)
+    {
+#if GLIB_CHECK_VERSION(2, 22, 0)
+      g_mapped_file_unref(mapped_file);
+#else
+      g_mapped_file_free(mapped_file);
+#endif
+      mapped_file = NULL;
+    }
+}
+
+
+//! Returns the number of records in the mapped file.
+int
+HistoryStore::get_day_count() const
+{
+  return mapped_file != NULL ? (int)header.day_count : 0;
+}
+
+
+//! Reads the specified record of the mapped file.
+/*!
+ *  \retval false the record is empty.
+ */
+bool
+HistoryStore::get_day(int index, IStatistics::DailyStats &stats) const
+{
+  if (mapped_file == NULL || index < 0 || index >= (int)header.day_count)
+    {
+      return false;
+    }
+
+  const guint8 *data = (const guint8 *) g_mapped_file_get_contents(mapped_file);
+  const guint8 *record = data + header.header_size + (gsize)index * header.record_size;
+
+  if ((get_uint32(record + RECORD_FLAGS) & RECORD_FLAG_PRESENT) == 0)
+    {
+      return false;
+    }
+
+  unpack_day(header, record, stats);
+  return true;
+}
+
+
+//! Stores the statistics of a single day in the history file.
+/*!
+ *  A day that is already stored is overwritten.
+ *
+ *  \retval false the day could not be stored in place; the file must be
+ *          rewritten with write_all.
+ */
+bool
+HistoryStore::write_day(const IStatistics::DailyStats &stats, gint64 source_size)
+{
+  TRACE_ENTER("HistoryStore::write_day");
+
+  close();
+
+  FILE *file = fopen(filename.c_str(), "r+b");
+  if (file == NULL)
+    {
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  guint8 header_data[HISTORY_HEADER_SIZE];
+  Header file_header;
+
+  long size = 0;
+  if (fseek(file, 0, SEEK_END) == 0)
+    {
+      size = ftell(file);
+    }
+
+  // Records can only be written in place if the layout matches.
+  bool ok = (size > 0 &&
+             fseek(file, 0, SEEK_SET) == 0 &&
+             fread(header_data, 1, sizeof(header_data), file) == sizeof(header_data) &&
+             unpack_header(header_data, size, file_header) &&
+             file_header.header_size == HISTORY_HEADER_SIZE &&
+             file_header.break_count == BREAK_ID_SIZEOF &&
+             file_header.break_value_count == IStatistics::STATS_BREAKVALUE_SIZEOF &&
+             file_header.value_count == IStatistics::STATS_VALUE_SIZEOF);
+
+  int day = get_day_number(stats.start);
+  if (ok && file_header.day_count > 0 && day < file_header.first_day)
+    {
+      TRACE_MSG("day precedes first day");
+      ok = false;
+    }
+
+  if (ok)
+    {
+      if (file_header.day_count == 0)
+        {
+          file_header.first_day = day;
+        }
+
+      guint32 index = day - file_header.first_day;
+      vector<guint8> record(file_header.record_size, 0);
+
+      // Fill the days between the last stored day and this day.
+      if (index > file_header.day_count)
+        {
+          ok = fseek(file, file_header.header_size + (long)file_header.day_count * file_header.record_size, SEEK_SET) == 0;
+          for (guint32 i = file_header.day_count; ok && i < index; i++)
+            {
+              ok = fwrite(&record[0], 1, record.size(), file) == record.size();
+            }
+        }
+
+      pack_day(stats, &record[0]);
+
+      ok = ok
+        && fseek(file, file_header.header_size + (long)index * file_header.record_size, SEEK_SET) == 0
+        && fwrite(&record[0], 1, record.size(), file) == record.size();
+
+      if (ok)
+        {
+          if (index >= file_header.day_count)
+            {
+              file_header.day_count = index + 1;
+            }
+          file_header.source_size = source_size;
+
+          pack_header(file_header, header_data);
+          ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(header_data, 1, sizeof(header_data), file) == sizeof(header_data);
+        }
+    }
+
+  ok = (fclose(file) == 0) && ok;
+
+  TRACE_RETURN(ok);
+  return ok;
+}
+
+
+//! Replaces the history file by a file containing the specified days.
+bool
+HistoryStore::write_all(const vector<IStatistics::DailyStats *> &days, gint64 source_size)
+{
+  TRACE_ENTER_MSG("HistoryStore::write_all", days.size());
+
+  close();
+
+  Header file_header;
+  init_header(file_header);
+  file_header.source_size = source_size;
+
+  int last_day = 0;
+  for (vector<IStatistics::DailyStats *>::const_iterator i = days.begin(); i != days.end(); i++)
+    {
+      int day = get_day_number((*i)->start);
+      if (i == days.begin() || day < file_header.first_day)
+        {
+          file_header.first_day = day;
+        }
+      if (i == days.begin() || day > last_day)
+        {
+          last_day = day;
+        }
+    }
+
+  if (!days.empty())
+    {
+      file_header.day_count = last_day - file_header.first_day + 1;
+    }
+
+  vector<guint8> data(file_header.header_size + (gsize)file_header.day_count * file_header.record_size, 0);
+  pack_header(file_header, &data[0]);
+
+  for (vector<IStatistics::DailyStats *>::const_iterator i = days.begin(); i != days.end(); i++)
+    {
+      int index = get_day_number((*i)->start) - file_header.first_day;
+      pack_day(**i, &data[file_header.header_size + (gsize)index * file_header.record_size]);
+    }
+
+  bool ok = g_file_set_contents(filename.c_str(), (const gchar *)&data[0], data.size(), NULL);
+
+  TRACE_RETURN(ok);
+  return ok;
+}
+
+
+//! Removes the history file.
+bool
+HistoryStore::remove()
+{
+  close();
+
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL)
+    {
+      return true;
+    }
+  fclose(file);
+
+  return std::remove(filename.c_str()) == 0;
+}
+
+
+//! Returns the number of days between 1 January 1970 and the specified date.
+int
+HistoryStore::get_day_number(const struct tm &date)
+{
+  return get_day_number(date.tm_year + 1900, date.tm_mon + 1, date.tm_mday);
+}
+
+
+//! Returns the number of days between 1 January 1970 and y/m/d.
+/*!
+ *  \param m month, 1 is January.
+ */
+int
+HistoryStore::get_day_number(int y, int m, int d)
+{
+  // Count years from 1 March so that the leap day is the last day of a year.
+  y -= (m <= 2);
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int year_of_era = y - era * 400;
+  int day_of_year = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+  return era * 146097 + day_of_era - 719468;
+}
+
+
+guint32
+HistoryStore::get_record_size(const Header &header)
+{
+  return RECORD_BREAK_STATS
+    + header.break_count * header.break_value_count * 4
+    + header.value_count * 8;
+}
+
+
+void
+HistoryStore::init_header(Header &header)
+{
+  header.version = HISTORY_VERSION;
+  header.header_size = HISTORY_HEADER_SIZE;
+  header.break_count = BREAK_ID_SIZEOF;
+  header.break_value_count = IStatistics::STATS_BREAKVALUE_SIZEOF;
+  header.value_count = IStatistics::STATS_VALUE_SIZEOF;
+  header.record_size = get_record_size(header);
+  header.first_day = 0;
+  header.day_count = 0;
+  header.source_size = 0;
+}
+
+
+void
+HistoryStore::pack_header(const Header &header, guint8 *data)
+{
+  memset(data, 0, HISTORY_HEADER_SIZE);
+  memcpy(data, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+  put_uint32(data + HEADER_VERSION, header.version);
+  put_uint32(data + HEADER_HEADER_SIZE, header.header_size);
+  put_uint32(data + HEADER_RECORD_SIZE, header.record_size);
+  put_uint32(data + HEADER_BREAK_COUNT, header.break_count);
+  put_uint32(data + HEADER_BREAK_VALUE_COUNT, header.break_value_count);
+  put_uint32(data + HEADER_VALUE_COUNT, header.value_count);
+  put_uint32(data + HEADER_FIRST_DAY, (guint32)header.first_day);
+  put_uint32(data + HEADER_DAY_COUNT, header.day_count);
+  put_int64(data + HEADER_SOURCE_SIZE, header.source_size);
+}
+
+
+//! Decodes and validates a header.
+/*!
+ *  \param size total size of the data, used to verify that all records
+ *         are present.
+ */
+bool
+HistoryStore::unpack_header(const guint8 *data, gsize size, Header &header)
+{
+  if (data == NULL || size < HISTORY_HEADER_SIZE || memcmp(data, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0)
+    {
+      return false;
+    }
+
+  header.version = get_uint32(data + HEADER_VERSION);
+  header.header_size = get_uint32(data + HEADER_HEADER_SIZE);
+  header.record_size = get_uint32(data + HEADER_RECORD_SIZE);
+  header.break_count = get_uint32(data + HEADER_BREAK_COUNT);
+  header.break_value_count = get_uint32(data + HEADER_BREAK_VALUE_COUNT);
+  header.value_count = get_uint32(data + HEADER_VALUE_COUNT);
+  header.first_day = (gint32)get_uint32(data + HEADER_FIRST_DAY);
+  header.day_count = get_uint32(data + HEADER_DAY_COUNT);
+  header.source_size = get_int64(data + HEADER_SOURCE_SIZE);
+
+  if (header.version != HISTORY_VERSION ||
+      header.header_size < HISTORY_HEADER_SIZE ||
+      header.break_count > 256 || header.break_value_count > 256 || header.value_count > 256 ||
+      header.record_size != get_record_size(header))
+    {
+      return false;
+    }
+
+  if (header.header_size > size ||
+      header.day_count > (size - header.header_size) / header.record_size)
+    {
+      return false;
+    }
+
+  return true;
+}
+
+
+void
+HistoryStore::pack_day(const IStatistics::DailyStats &stats, guint8 *data)
+{
+  put_uint32(data + RECORD_FLAGS, RECORD_FLAG_PRESENT);
+  put_date(data + RECORD_START, stats.start);
+  put_date(data + RECORD_STOP, stats.stop);
+
+  guint8 *p = data + RECORD_BREAK_STATS;
+  for (int i = 0; i < BREAK_ID_SIZEOF; i++)
+    {
+      for (int j = 0; j < IStatistics::STATS_BREAKVALUE_SIZEOF; j++)
+        {
+          put_uint32(p, stats.break_stats[i][j]);
+          p += 4;
+        }
+    }
+
+  for (int j = 0; j < IStatistics::STATS_VALUE_SIZEOF; j++)
+    {
+      put_int64(p, stats.misc_stats[j]);
+      p += 8;
+    }
+}
+
+
+//! Decodes a record that may have been written with different counts.
+void
+HistoryStore::unpack_day(const Header &header, const guint8 *data, IStatistics::DailyStats &stats)
+{
+  get_date(data + RECORD_START, stats.start);
+  get_date(data + RECORD_STOP, stats.stop);
+
+  const guint8 *p = data + RECORD_BREAK_STATS;
+  for (guint32 i = 0; i < header.break_count; i++)
+    {
+      for (guint32 j = 0; j < header.break_value_count; j++)
+        {
+          if (i < BREAK_ID_SIZEOF && j < IStatistics::STATS_BREAKVALUE_SIZEOF)
+            {
+              stats.break_stats[i][j] = (gint32)get_uint32(p);
+            }
+          p += 4;
+        }
+    }
+
+  for (guint32 j = 0; j < header.value_count; j++)
+    {
+      if (j < IStatistics::STATS_VALUE_SIZEOF)
+        {
+          stats.misc_stats[j] = get_int64(p);
+        }
+      p += 8;
+    }
+}
@@ -0,0 +1,97 @@
+// HistoryStore.hh --- Binary storage of the statistics history
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef HISTORYSTORE_HH
+#define HISTORYSTORE_HH
+
+#include <string>
+#include <vector>
+#include <time.h>
+
+#include <glib.h>
+
+#include "IStatistics.hh"
+
+using namespace workrave;
+
+//! Binary file with the statistics of all past days.
+/*!
+ *  The file starts with a fixed size header, followed by one fixed size
+ *  record per day. Record i holds the day first_day + i, so the record of
+ *  any day is found without searching. Days without statistics have an
+ *  empty record. All values are stored little-endian.
+ *
+ *  The file is memory mapped while it is read. New days are written in
+ *  place; the file is only rewritten when a day before the first day is
+ *  added.
+ */
+class HistoryStore
+{
+public:
+  HistoryStore();
+  ~HistoryStore();
+
+  void init(const std::string &filename);
+
+  bool open(gint64 source_size);
+  void close();
+
+  int get_day_count() const;
+  bool get_day(int index, IStatistics::DailyStats &stats) const;
+
+  bool write_day(const IStatistics::DailyStats &stats, gint64 source_size);
+  bool write_all(const std::vector<IStatistics::DailyStats *> &days, gint64 source_size);
+  bool remove();
+
+  static int get_day_number(const struct tm &date);
+  static int get_day_number(int y, int m, int d);
+
+private:
+  struct Header
+  {
+    guint32 version;
+    guint32 header_size;
+    guint32 record_size;
+    guint32 break_count;
+    guint32 break_value_count;
+    guint32 value_count;
+    gint32 first_day;
+    guint32 day_count;
+    gint64 source_size;
+  };
+
+  static guint32 get_record_size(const Header &header);
+  static void init_header(Header &header);
+  static void pack_header(const Header &header, guint8 *data);
+  static bool unpack_header(const guint8 *data, gsize size, Header &header);
+  static void pack_day(const IStatistics::DailyStats &stats, guint8 *data);
+  static void unpack_day(const Header &header, const guint8 *data, IStatistics::DailyStats &stats);
+
+private:
+  //! Name of the file.
+  std::string filename;
+
+  //! Mapping of the file while it is open.
+  GMappedFile *mapped_file;
+
+  //! Header of the mapped file.
+  Header header;
+};
+
+#endif // HISTORYSTORE_HH
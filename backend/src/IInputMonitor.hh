@@ -46,6 +46,12 @@ public:
 
   //! Unsubscribe for statistics monitor.
   virtual void unsubscribe_statistics(IInputMonitorListener *listener) = 0;
+
+  //! Delivers all queued input events to the listeners. Called from the main thread.
+  virtual void dispatch_events() = 0;
+
+  //! Requests that the activity listener is woken up by the next input event.
+  virtual void request_wakeup() = 0;
 };
 
 #endif // IINPUTMONITOR_HH
@@ -22,23 +22,20 @@
 
 #include <string>
 
+struct InputEvent;
+
 //! Listener for events from the input monitor.
 class IInputMonitorListener
 {
 public:
   virtual ~IInputMonitorListener() {}
 
-  //! Generic user activity (if no details info is available)
-  virtual void action_notify() = 0;
-
-  //! Reports mouse movement activity
-  virtual void mouse_notify(int x, int y, int wheel = 0) = 0;
-
-  //! Reports mouse button activity
-  virtual void button_notify(bool is_press) = 0;
+  //! Reports a batch of input events. Called from the main thread.
+  virtual void input_events_notify(const InputEvent *events, int count) = 0;
 
-  //! Reports keyboard activity
-  virtual void keyboard_notify(bool repeat) = 0;
+  //! Reports the first input event after a wakeup was requested.
+  /*! Called from the thread of the input monitor. */
+  virtual void wakeup_notify() = 0;
 };
 
 #endif // IINPUTMONITORLISTENER_HH
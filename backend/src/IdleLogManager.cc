@@ -29,6 +29,7 @@
 #include "debug.hh"
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <assert.h>
 
 #ifdef HAVE_UNISTD_H
@@ -39,20 +40,26 @@
 #include "IdleLogManager.hh"
 #include "TimeSource.hh"
 #include "PacketBuffer.hh"
+#include "PersistenceManager.hh"
 
 #define IDLELOG_MAXSIZE     (4000)
 #define IDLELOG_MAXAGE    (12 * 60 * 60)
 #define IDLELOG_INTERVAL    (30 * 60)
 #define IDLELOG_VERSION   (3)
 #define IDLELOG_INTERVAL_SIZE (17)
+#define IDLELOG_SYNC_INTERVAL (60)
 
 
 //! Constructs a new idlelog manager.
-IdleLogManager::IdleLogManager(string myid, const TimeSource *time_source)
+IdleLogManager::IdleLogManager(string myid, const TimeSource *time_source, PersistenceManager *persistence)
 {
   this->myid = myid;
   this->time_source = time_source;
+  this->persistence_manager = persistence;
   this->last_expiration_time = 0;
+  this->last_sync_time = 0;
+  this->timeline_active_time = 0;
+  this->timeline_valid = false;
 }
 
 
@@ -118,6 +125,7 @@ IdleLogManager::init()
   TRACE_ENTER("IdleLogManager::init()");
 
   load();
+  timeline_valid = false;
 
   if (clients.find(myid) == clients.end())
     {
@@ -156,14 +164,17 @@ IdleLogManager::expire()
     {
       last_expiration_time = current_time +  IDLELOG_INTERVAL;
     }
-  else if (current_time <= last_expiration_time)
+  else if (current_time >= last_expiration_time)
     {
       last_expiration_time = current_time +  IDLELOG_INTERVAL;
       for (ClientMapIter i = clients.begin(); i != clients.end(); i++)
         {
           ClientInfo &info = (*i).second;
           expire(info);
+          compact(info);
         }
+
+      save_index();
     }
 }
 
@@ -175,37 +186,52 @@ IdleLogManager::expire(ClientInfo &info)
   if (info.idlelog.size() > IDLELOG_MAXSIZE)
     {
       info.idlelog.resize(IDLELOG_MAXSIZE);
+      timeline_valid = false;
     }
 
+  // Find the oldest interval that has not expired.
   time_t current_time = time_source->get_time();
-  int count = 0;
-  for (IdleLogRIter i = info.idlelog.rbegin(); i != info.idlelog.rend(); i++)
+  IdleLogIter keep_end = info.idlelog.end();
+  while (keep_end != info.idlelog.begin() &&
+         (keep_end - 1)->end_idle_time < current_time - IDLELOG_MAXAGE)
     {
-      IdleInterval &idle = info.idlelog.back();
-      if (idle.end_idle_time < current_time - IDLELOG_MAXAGE)
-        {
-          count++;
-        }
-      else
-        {
-          break;
-        }
+      keep_end--;
     }
 
-  if (count != 0)
+  if (keep_end != info.idlelog.end())
     {
-      if (info.idlelog.size() > (size_t)count)
-        {
-          info.idlelog.resize(info.idlelog.size() - count);
-        }
-      else
-        {
-          info.idlelog.clear();
-        }
+      info.idlelog.erase(keep_end, info.idlelog.end());
+      timeline_valid = false;
     }
 }
 
 
+//! Removes expired intervals from the idle log file.
+/*!
+ *  Intervals are appended to the idle log file as they are closed. The
+ *  file is only rewritten when it contains intervals that have expired.
+ */
+void
+IdleLogManager::compact(ClientInfo &info)
+{
+  TRACE_ENTER_MSG("IdleLogManager::compact", info.client_id << " " << info.journal_size);
+
+  // The most recent interval may not have been appended yet.
+  int num_saved = info.idlelog.size();
+  if (num_saved > 0 && info.idlelog.front().to_be_saved)
+    {
+      num_saved--;
+    }
+
+  if (info.journal_size > num_saved)
+    {
+      save_idlelog(info);
+    }
+
+  TRACE_EXIT();
+}
+
+
 //! Update the idle log of a single client.
 void
 IdleLogManager::update_idlelog(ClientInfo &info, ActivityState state, bool master)
@@ -243,6 +269,7 @@ IdleLogManager::update_idlelog(ClientInfo &info, ActivityState state, bool maste
           // Push current
           info.current_interval.to_be_saved = true;
           info.idlelog.push_front(info.current_interval);
+          timeline_valid = false;
 
           // create a new (empty) idle interval.
           info.current_interval = IdleInterval(current_time, current_time);
@@ -287,6 +314,7 @@ IdleLogManager::update_idlelog(ClientInfo &info, ActivityState state, bool maste
                 {
                   info.current_interval = oldidle;
                   info.idlelog.pop_front();
+                  timeline_valid = false;
                   idle = &(info.current_interval);
                 }
             }
@@ -331,54 +359,93 @@ IdleLogManager::compute_total_active_time()
 time_t
 IdleLogManager::compute_active_time(int length)
 {
-  TRACE_ENTER("IdleLogManager::compute_active_time");
+  TRACE_ENTER_MSG("IdleLogManager::compute_active_time", length);
 
   time_t current_time = time_source->get_time();
+  for (ClientMapIter i = clients.begin(); i != clients.end(); i++)
+    {
+      i->second.update_active_time(current_time);
+    }
+
+  update_timeline();
+
+  // Find the most recent common idle period that is longer than length.
+  time_t active_time = timeline_active_time;
+
+  int low = 0;
+  int high = timeline.size();
+  while (low < high)
+    {
+      int mid = (low + high) / 2;
+      if (timeline[mid].max_length > length)
+        {
+          high = mid;
+        }
+      else
+        {
+          low = mid + 1;
+        }
+    }
+
+  if (low < int(timeline.size()))
+    {
+      active_time = timeline[low].active_time;
+    }
+
+  TRACE_MSG("total = " << active_time);
+  TRACE_EXIT();
+  return active_time;
+}
+
+
+//! Merges the idle logs of all clients into a timeline of common idle periods.
+/*!
+ *  The timeline is only rebuilt after an idle log was modified. It answers
+ *  compute_active_time for any length, so all breaks share a single merge.
+ */
+void
+IdleLogManager::update_timeline()
+{
+  if (timeline_valid)
+    {
+      return;
+    }
+
+  TRACE_ENTER("IdleLogManager::update_timeline");
+
+  timeline.clear();
+  timeline_active_time = 0;
 
   // Number of client.
   int size = clients.size();
 
   // Data for each client.
-  IdleLogIter *iterators = new IdleLogIter[size];
-  IdleLogIter *end_iterators = new IdleLogIter[size];
-  bool *at_end = new bool[size];
-  time_t *active_time = new time_t[size];
+  vector<IdleLogIter> iterators;
+  vector<IdleLogIter> end_iterators;
+  vector<bool> at_end(size, true);
 
-  // Init data for all clients.
-  int count = 0;
   for (ClientMapIter i = clients.begin(); i != clients.end(); i++)
     {
       ClientInfo &info = (*i).second;
 
-      iterators[count] = info.idlelog.begin();
-      end_iterators[count] = info.idlelog.end();
-      active_time[count] = 0;
-      at_end[count] = true;
-
-      info.update_active_time(current_time);
-      count++;
+      iterators.push_back(info.idlelog.begin());
+      end_iterators.push_back(info.idlelog.end());
     }
 
-
   // Number of simultaneous idle periods.
   int idle_count = 0;
 
-  // Time of last unprocessed event.
-  time_t last_time = -1;
-
-  // Iterator of last unprocessed event.
-  int last_iter = -1;
-
-  // Stop criterium
-  bool stop = false;
-
-  // Begin and End time of idle perdiod.
+  // End time of the most recent idle period that was processed.
   time_t end_idle_time = -1;
 
-  while (!stop)
+  // Longest common idle period so far.
+  time_t max_length = -1;
+
+  while (true)
     {
       // Find latest event.
-      last_time = -1;
+      time_t last_time = -1;
+      int last_iter = -1;
       for (int i = 0; i < size; i ++)
         {
           if (iterators[i] != end_iterators[i])
@@ -394,60 +461,48 @@ IdleLogManager::compute_active_time(int length)
             }
         }
 
-      // Did we found one?
-      if (last_time != -1)
+      if (last_time == -1)
         {
-          IdleInterval &ii = *(iterators[last_iter]);
-          if (at_end[last_iter])
-            {
-              TRACE_MSG("End time " << ii.end_idle_time << " active " << ii.active_time);
-              idle_count++;
+          break;
+        }
 
-              at_end[last_iter] = false;
-              active_time[last_iter] += ii.active_time;
-              end_idle_time = ii.end_idle_time;
-            }
-          else
-            {
-              TRACE_MSG("Begin time " << ii.begin_time);
+      IdleInterval &ii = *(iterators[last_iter]);
+      if (at_end[last_iter])
+        {
+          idle_count++;
 
-              at_end[last_iter] = true;
-              iterators[last_iter]++;
+          at_end[last_iter] = false;
+          timeline_active_time += ii.active_time;
+          end_idle_time = ii.end_idle_time;
+        }
+      else
+        {
+          at_end[last_iter] = true;
+          iterators[last_iter]++;
 
-              if (idle_count == size)
+          if (idle_count == size)
+            {
+              time_t length = end_idle_time - ii.begin_time;
+              if (length > max_length)
                 {
-                  TRACE_MSG("Common idle period of " << (end_idle_time - ii.begin_time));
-                  if ((end_idle_time - ii.begin_time) > length)
-                    {
-                      stop = true;
-                    }
-                }
+                  max_length = length;
 
-              idle_count--;
+                  // Shorter periods are never the first to exceed a length.
+                  CommonIdle common;
+                  common.max_length = max_length;
+                  common.active_time = timeline_active_time;
+                  timeline.push_back(common);
+                }
             }
-        }
-      else
-        {
-          stop = true;
-        }
-    }
 
-  time_t total_active_time = 0;
-  for (int i = 0; i < size; i++)
-    {
-      TRACE_MSG("active time of " << i << " = " << active_time[i]);
-      total_active_time += active_time[i];
+          idle_count--;
+        }
     }
 
-  TRACE_MSG("total = " << total_active_time);
-
-  delete [] iterators;
-  delete [] end_iterators;
-  delete [] at_end;
-  delete [] active_time;
+  timeline_valid = true;
 
+  TRACE_MSG("common idle periods = " << timeline.size() << " total = " << timeline_active_time);
   TRACE_EXIT();
-  return total_active_time;
 }
 
 
@@ -534,9 +589,45 @@ IdleLogManager::unpack_idle_interval(PacketBuffer &buffer, IdleInterval &idle, t
 }
 
 
+//! Packs the idle interval relative to the more recent interval that was packed before it.
+/*!
+ *  The times are packed as variable length differences, so that an
+ *  interval typically takes a few bytes instead of seventeen. ref_time
+ *  is the begin time of the previous interval, or the pack time for the
+ *  first one, and is updated for the next interval.
+ */
+void
+IdleLogManager::pack_idle_interval(PacketBuffer &buffer, const IdleInterval &idle, time_t &ref_time) const
+{
+  buffer.pack_svarint((gint32)(ref_time - idle.end_time));
+  buffer.pack_svarint((gint32)(idle.end_time - idle.end_idle_time));
+  buffer.pack_svarint((gint32)(idle.end_idle_time - idle.begin_time));
+  buffer.pack_varint((guint32)idle.active_time);
+
+  ref_time = idle.begin_time;
+}
+
+
+//! Unpacks an idle interval packed relative to the previous interval.
+void
+IdleLogManager::unpack_idle_interval(PacketBuffer &buffer, IdleInterval &idle, time_t &ref_time, time_t delta_time) const
+{
+  time_t end_time = ref_time - buffer.unpack_svarint();
+  time_t end_idle_time = end_time - buffer.unpack_svarint();
+  time_t begin_time = end_idle_time - buffer.unpack_svarint();
+
+  idle.begin_time = begin_time - delta_time;
+  idle.end_idle_time = end_idle_time - delta_time;
+  idle.end_time = end_time - delta_time;
+  idle.active_time = buffer.unpack_varint();
+
+  ref_time = begin_time;
+}
+
+
 //! Packs the idlelog header to the buffer.
 void
-IdleLogManager::pack_idlelog(PacketBuffer &buffer, const ClientInfo &ci) const
+IdleLogManager::pack_idlelog(PacketBuffer &buffer, const ClientInfo &ci, int num_intervals) const
 {
   time_t current_time = time_source->get_time();
 
@@ -550,7 +641,7 @@ IdleLogManager::pack_idlelog(PacketBuffer &buffer, const ClientInfo &ci) const
   buffer.pack_ulong((guint32)ci.total_active_time);
   buffer.pack_byte(ci.master);
   buffer.pack_byte(ci.state);
-  buffer.pack_ushort(ci.idlelog.size());
+  buffer.pack_ushort(num_intervals);
 
   buffer.update_size(pos);
 }
@@ -649,16 +740,11 @@ IdleLogManager::save_index()
       info.update_active_time(time_source->get_time());
       TRACE_MSG("Saving " << i->first << " " << info.client_id);
 
-      pack_idlelog(buffer, info);
+      pack_idlelog(buffer, info, info.idlelog.size());
     }
 
-  stringstream ss;
-  ss << Util::get_home_directory();
-  ss << "idlelog.idx" << ends;
-
-  ofstream file(ss.str().c_str(), ios::binary);
-  file.write(buffer.get_buffer(), buffer.bytes_written());
-  file.close();
+  persistence_manager->write_file(Util::get_home_directory() + "idlelog.idx",
+                                  string(buffer.get_buffer(), buffer.bytes_written()));
 
   TRACE_EXIT();
 }
@@ -762,20 +848,23 @@ IdleLogManager::save_idlelog(ClientInfo &info)
   PacketBuffer buffer;
   buffer.create();
 
+  info.journal_size = 0;
   for (IdleLogRIter i = info.idlelog.rbegin(); i != info.idlelog.rend(); i++)
     {
       IdleInterval &idle = *i;
 
-      pack_idle_interval(buffer, idle);
+      if (!idle.to_be_saved)
+        {
+          pack_idle_interval(buffer, idle);
+          info.journal_size++;
+        }
     }
 
   stringstream ss;
   ss << Util::get_home_directory();
-  ss << "idlelog." << info.client_id << ".log" << ends;
+  ss << "idlelog." << info.client_id << ".log";
 
-  ofstream file(ss.str().c_str(), ios::binary);
-  file.write(buffer.get_buffer(), buffer.bytes_written());
-  file.close();
+  persistence_manager->write_file(ss.str(), string(buffer.get_buffer(), buffer.bytes_written()));
 }
 
 
@@ -799,9 +888,12 @@ IdleLogManager::load_idlelog(ClientInfo &info)
   int size=pbuf->pubseekoff (0,ios::end,ios::in);
   pbuf->pubseekpos (0,ios::in);
 
-  // Process it.
+  // Process it. An incomplete interval at the end of the file is ignored.
   int num_intervals = size / IDLELOG_INTERVAL_SIZE;
-  if (num_intervals * IDLELOG_INTERVAL_SIZE == size)
+  bool incomplete = (size > 0 && num_intervals * IDLELOG_INTERVAL_SIZE != size);
+  size = num_intervals * IDLELOG_INTERVAL_SIZE;
+  info.journal_size = num_intervals;
+  if (num_intervals > 0)
     {
       if (num_intervals > IDLELOG_MAXSIZE)
         {
@@ -841,6 +933,12 @@ IdleLogManager::load_idlelog(ClientInfo &info)
   dump_idlelog(info);
   fix_idlelog(info);
   dump_idlelog(info);
+
+  if (incomplete)
+    {
+      // Don't append after a partially written interval.
+      save_idlelog(info);
+    }
   TRACE_EXIT();
 }
 
@@ -864,13 +962,33 @@ IdleLogManager::load()
 void
 IdleLogManager::save()
 {
-  save_index();
-
   for (ClientMapIter i = clients.begin(); i != clients.end(); i++)
     {
       ClientInfo &info = (*i).second;
-      save_idlelog(info);
+
+      stringstream ss;
+      ss << Util::get_home_directory();
+      ss << "idlelog." << info.client_id << ".log";
+
+      if (persistence_manager->check_append_failed(ss.str()))
+        {
+          // The journal lost intervals; write all of them.
+          info.journal_size = -1;
+        }
+
+      if (info.idlelog.size() > 0 && info.idlelog.front().to_be_saved)
+        {
+          update_idlelog(info, info.idlelog.front());
+          info.idlelog.front().to_be_saved = false;
+        }
+
+      if (info.journal_size != (int)info.idlelog.size())
+        {
+          save_idlelog(info);
+        }
     }
+
+  save_index();
 }
 
 
@@ -887,36 +1005,114 @@ IdleLogManager::update_idlelog(ClientInfo &info, const IdleInterval &idle)
 
   stringstream ss;
   ss << Util::get_home_directory();
-  ss << "idlelog." << info.client_id << ".log" << ends;
+  ss << "idlelog." << info.client_id << ".log";
+
+  persistence_manager->append_file(ss.str(), string(buffer.get_buffer(), buffer.bytes_written()));
+  info.journal_size++;
+}
 
-  ofstream file(ss.str().c_str(), ios::app | ios::binary);
-  file.write(buffer.get_buffer(), buffer.bytes_written());
-  file.close();
 
-  save_index();
+
+//! Returns the clients that should receive my idle log now.
+/*!
+ *  A client that signed on receives it as soon as possible. All signed
+ *  on clients receive the intervals they did not confirm periodically.
+ */
+void
+IdleLogManager::get_idlelog_receivers(list<string> &client_ids)
+{
+  time_t current_time = time_source->get_time();
+
+  if (current_time >= last_sync_time + IDLELOG_SYNC_INTERVAL)
+    {
+      last_sync_time = current_time;
+      for (ConfirmedTimes::const_iterator i = confirmed_times.begin(); i != confirmed_times.end(); i++)
+        {
+          client_ids.push_back(i->first);
+        }
+    }
+  else
+    {
+      client_ids.insert(client_ids.end(), unsent_clients.begin(), unsent_clients.end());
+    }
 }
 
 
+//! My idle log was sent to the specified client.
+void
+IdleLogManager::idlelog_sent(const string &client_id)
+{
+  unsent_clients.erase(client_id);
+}
+
 
+//! Packs my idle log for the specified client.
+/*!
+ *  Only the intervals that the client did not confirm are sent, including
+ *  the most recent confirmed one, as it may have changed since. The
+ *  intervals follow the header in compact form, together with the
+ *  confirmations of the idle logs received from the other clients.
+ */
 void
-IdleLogManager::get_idlelog(PacketBuffer &buffer)
+IdleLogManager::get_idlelog(PacketBuffer &buffer, const string &client_id)
 {
-  TRACE_ENTER("IdleLogManager::get_idlelog");
+  TRACE_ENTER_MSG("IdleLogManager::get_idlelog", client_id);
+
+  time_t current_time = time_source->get_time();
 
   // Information about me.
   ClientInfo &myinfo = clients[myid];
 
   // First make sure that all data is up-to-date.
-  myinfo.update_active_time(time_source->get_time());
+  myinfo.update_active_time(current_time);
 
-  // Pack header.
-  pack_idlelog(buffer, myinfo);
+  // Zero if the client needs the complete idle log.
+  time_t base_time = 0;
+  ConfirmedTimes::const_iterator it = confirmed_times.find(client_id);
+  if (it != confirmed_times.end())
+    {
+      base_time = it->second;
+    }
+  TRACE_MSG("base = " << base_time);
 
-  for (IdleLogIter i = myinfo.idlelog.begin(); i != myinfo.idlelog.end(); i++)
+  // Pack header. Clients that only know the fixed size intervals see an empty log.
+  pack_idlelog(buffer, myinfo, 0);
+
+  int pos = 0;
+  buffer.reserve_size(pos);
+  buffer.pack_ulong((guint32)base_time);
+
+  int count_pos = buffer.bytes_written();
+  int count = 0;
+  buffer.pack_ushort(0);
+
+  for (ClientMapIter i = clients.begin(); i != clients.end(); i++)
     {
-      pack_idle_interval(buffer, *i);
+      ClientInfo &info = (*i).second;
+      if (i->first != myid && info.received_time != 0)
+        {
+          buffer.pack_string(i->first.c_str());
+          buffer.pack_ulong((guint32)info.received_time);
+          count++;
+        }
     }
+  buffer.poke_ushort(count_pos, count);
+
+  count_pos = buffer.bytes_written();
+  count = 0;
+  buffer.pack_ushort(0);
+
+  time_t ref_time = current_time;
+  for (IdleLogIter i = myinfo.idlelog.begin(); i != myinfo.idlelog.end() && i->begin_time >= base_time; i++)
+    {
+      pack_idle_interval(buffer, *i, ref_time);
+      count++;
+    }
+  buffer.poke_ushort(count_pos, count);
+
+  buffer.update_size(pos);
 
+  TRACE_MSG("intervals = " << count << " bytes = " << buffer.bytes_written());
   TRACE_EXIT();
 }
 
@@ -926,17 +1122,40 @@ IdleLogManager::set_idlelog(PacketBuffer &buffer)
 {
   TRACE_ENTER("IdleLogManager::set_idlelog");
 
-  time_t delta_time = 0;
   time_t pack_time = 0;
   int num_intervals = 0;
 
   ClientInfo info;
   unpack_idlelog(buffer, info, pack_time, num_intervals);
 
-  delta_time = pack_time - time_source->get_time();
-  clients[info.client_id] = info;
+  timeline_valid = false;
   info.last_update_time = 0;
 
+  if (num_intervals == 0 && buffer.bytes_available() > 0)
+    {
+      unpack_incremental_idlelog(buffer, info, pack_time);
+    }
+  else
+    {
+      unpack_legacy_idlelog(buffer, info, pack_time, num_intervals);
+    }
+
+  fix_idlelog(info);
+  save_index();
+  save_idlelog(clients[info.client_id]);
+
+  TRACE_EXIT();
+}
+
+
+//! Replaces the idle log of a client by fixed size intervals.
+void
+IdleLogManager::unpack_legacy_idlelog(PacketBuffer &buffer, ClientInfo &info, time_t pack_time, int num_intervals)
+{
+  time_t delta_time = pack_time - time_source->get_time();
+
+  clients[info.client_id] = info;
+
   for (int i = 0; i < num_intervals; i++)
     {
       IdleInterval idle;
@@ -945,11 +1164,115 @@ IdleLogManager::set_idlelog(PacketBuffer &buffer)
       TRACE_MSG(info.client_id << " " << idle.begin_time << " " << idle.end_idle_time << " " << idle.active_time);
       clients[info.client_id].idlelog.push_back(idle);
     }
+}
 
-  fix_idlelog(info);
-  save_index();
-  save_idlelog(clients[info.client_id]);
 
+//! Merges compact intervals into the idle log of a client.
+/*!
+ *  A complete idle log replaces the known one. Otherwise, the received
+ *  intervals replace the known intervals that are as recent or more
+ *  recent. Intervals are only merged if this client confirmed the
+ *  intervals the sender omitted; if not, the intervals are ignored and
+ *  the next confirmation asks for the complete idle log.
+ */
+void
+IdleLogManager::unpack_incremental_idlelog(PacketBuffer &buffer, ClientInfo &info, time_t pack_time)
+{
+  TRACE_ENTER_MSG("IdleLogManager::unpack_incremental_idlelog", info.client_id);
+
+  int pos = 0;
+  int size = buffer.read_size(pos);
+
+  if (size <= 0 || buffer.bytes_available() < size)
+    {
+      buffer.clear();
+      TRACE_RETURN("Invalid size");
+      return;
+    }
+
+  time_t base_time = buffer.unpack_ulong();
+
+  // A client that does not confirm my idle log needs all of it.
+  time_t confirmed_time = 0;
+
+  int num_confirmed = buffer.unpack_ushort();
+  for (int i = 0; i < num_confirmed; i++)
+    {
+      gchar *id = buffer.unpack_string();
+      time_t t = buffer.unpack_ulong();
+
+      if (id != NULL && myid == id)
+        {
+          confirmed_time = t;
+        }
+      g_free(id);
+    }
+
+  ConfirmedTimes::iterator it = confirmed_times.find(info.client_id);
+  if (it != confirmed_times.end())
+    {
+      it->second = confirmed_time;
+    }
+
+  ClientInfo &ci = clients[info.client_id];
+
+  bool complete = (base_time == 0);
+  bool mergeable = complete || (ci.received_time != 0 && ci.received_time >= base_time);
+
+  // Clock differences are only measured at a complete exchange, so that
+  // merged intervals line up with the known ones.
+  time_t delta_time = complete ? pack_time - time_source->get_time() : ci.delta_time;
+  time_t received_time = complete ? 0 : ci.received_time;
+
+  IdleLog previous;
+  if (!complete)
+    {
+      previous.swap(ci.idlelog);
+    }
+
+  ci = info;
+  ci.delta_time = delta_time;
+
+  if (!mergeable)
+    {
+      TRACE_MSG("Missing intervals");
+      ci.idlelog.swap(previous);
+      buffer.skip_size(pos);
+      TRACE_EXIT();
+      return;
+    }
+
+  int num_intervals = buffer.unpack_ushort();
+  time_t ref_time = pack_time;
+
+  for (int i = 0; i < num_intervals; i++)
+    {
+      IdleInterval idle;
+      unpack_idle_interval(buffer, idle, ref_time, delta_time);
+
+      if (i == 0)
+        {
+          received_time = ref_time;
+        }
+
+      TRACE_MSG(info.client_id << " " << idle.begin_time << " " << idle.end_idle_time << " " << idle.active_time);
+      ci.idlelog.push_back(idle);
+    }
+  ci.received_time = received_time;
+
+  if (num_intervals > 0)
+    {
+      time_t oldest_time = ci.idlelog.back().begin_time;
+      while (!previous.empty() && previous.front().begin_time >= oldest_time)
+        {
+          previous.pop_front();
+        }
+    }
+  ci.idlelog.insert(ci.idlelog.end(), previous.begin(), previous.end());
+
+  buffer.skip_size(pos);
+
+  TRACE_MSG("intervals = " << num_intervals << " total = " << ci.idlelog.size());
   TRACE_EXIT();
 }
 
@@ -965,6 +1288,12 @@ IdleLogManager::signon_remote_client(string client_id)
   ClientInfo &info = clients[client_id];
   info.idlelog.push_front(IdleInterval(1, current_time));
   info.client_id = client_id;
+  info.received_time = 0;
+  timeline_valid = false;
+
+  // The client receives my complete idle log until it confirms otherwise.
+  confirmed_times[client_id] = 0;
+  unsent_clients.insert(client_id);
 
   save_index();
   save_idlelog(info);
@@ -981,6 +1310,10 @@ IdleLogManager::signoff_remote_client(string client_id)
 
   clients[client_id].state = ACTIVITY_IDLE;
   clients[client_id].master = false;
+  timeline_valid = false;
+
+  confirmed_times.erase(client_id);
+  unsent_clients.erase(client_id);
 
   TRACE_EXIT();
 }
@@ -1100,6 +1433,7 @@ IdleLogManager::fix_idlelog(ClientInfo &info)
     }
 
   info.idlelog.push_front(IdleInterval(next_time, current_time));
+  timeline_valid = false;
 
   TRACE_EXIT();
 }
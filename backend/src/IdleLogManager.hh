@@ -37,8 +37,11 @@
 
 #include <iostream>
 #include <string>
+#include <deque>
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
 
 using namespace std;
 
@@ -46,6 +49,7 @@ using namespace std;
 
 class TimeSource;
 class PacketBuffer;
+class PersistenceManager;
 
 class IdleLogManager
 {
@@ -88,7 +92,8 @@ private:
   };
 
 
-  typedef list<IdleInterval> IdleLog;
+  //! Idle intervals, most recent first. Stored in contiguous chunks.
+  typedef deque<IdleInterval> IdleLog;
   typedef IdleLog::iterator IdleLogIter;
   typedef IdleLog::reverse_iterator IdleLogRIter;
 
@@ -101,7 +106,10 @@ private:
       total_active_time(0),
       last_active_begin_time(0),
       last_active_time(0),
-      last_update_time()
+      last_update_time(),
+      journal_size(0),
+      received_time(0),
+      delta_time(0)
     {
     }
 
@@ -132,6 +140,15 @@ private:
     //! Last time this idle log was updated.
     time_t last_update_time;
 
+    //! Number of intervals in the idle log file.
+    int journal_size;
+
+    //! Begin time, in the clock of the client, of the most recent interval received from it.
+    time_t received_time;
+
+    //! Clock difference with the client at the last complete exchange.
+    time_t delta_time;
+
     //! Update the active time of the most recent idle interval.
     void update_active_time(time_t current_time)
     {
@@ -149,6 +166,23 @@ private:
   typedef map<string, ClientInfo> ClientMap;
   typedef ClientMap::iterator ClientMapIter;
 
+  //! Begin time of the most recent interval of my idle log that each client received.
+  typedef map<string, time_t> ConfirmedTimes;
+
+  typedef set<string> ClientIds;
+
+  //! An idle period that all clients have in common.
+  struct CommonIdle
+  {
+    //! Length of the longest common idle period up to this one, counting from the most recent.
+    time_t max_length;
+
+    //! Active time of all clients after this idle period.
+    time_t active_time;
+  };
+
+  typedef vector<CommonIdle> Timeline;
+
 private:
   // My ID
   string myid;
@@ -156,14 +190,35 @@ private:
   //! Info about all clients.
   ClientMap clients;
 
+  //! Intervals of my idle log confirmed by the clients that are signed on.
+  ConfirmedTimes confirmed_times;
+
+  //! Signed on clients that did not receive my idle log yet.
+  ClientIds unsent_clients;
+
+  //! Last time my idle log was sent to all signed on clients.
+  time_t last_sync_time;
+
   //! Time
   const TimeSource *time_source;
 
+  //! Writes the idle logs.
+  PersistenceManager *persistence_manager;
+
   //! Last time we performed an expiration run.
   time_t last_expiration_time;
 
+  //! Common idle periods of all clients, most recent first.
+  Timeline timeline;
+
+  //! Active time in all idle logs.
+  time_t timeline_active_time;
+
+  //! Does the timeline match the idle logs?
+  bool timeline_valid;
+
 public:
-  IdleLogManager(string myid, const TimeSource *control);
+  IdleLogManager(string myid, const TimeSource *control, PersistenceManager *persistence);
 
   void update_all_idlelogs(string master_id, ActivityState state);
   void reset();
@@ -173,7 +228,9 @@ public:
   void signon_remote_client(string client_id);
   void signoff_remote_client(string client_id);
 
-  void get_idlelog(PacketBuffer &buffer);
+  void get_idlelog_receivers(list<string> &client_ids);
+  void idlelog_sent(const string &client_id);
+  void get_idlelog(PacketBuffer &buffer, const string &client_id);
   void set_idlelog(PacketBuffer &buffer);
 
   time_t compute_total_active_time();
@@ -184,13 +241,20 @@ private:
   void update_idlelog(ClientInfo &info, ActivityState state, bool master);
   void expire();
   void expire(ClientInfo &info);
+  void compact(ClientInfo &info);
 
   void pack_idle_interval(PacketBuffer &buffer, const IdleInterval &idle) const;
   void unpack_idle_interval(PacketBuffer &buffer, IdleInterval &idle, time_t delta_time) const;
+  void pack_idle_interval(PacketBuffer &buffer, const IdleInterval &idle, time_t &ref_time) const;
+  void unpack_idle_interval(PacketBuffer &buffer, IdleInterval &idle, time_t &ref_time, time_t delta_time) const;
 
-  void pack_idlelog(PacketBuffer &buffer, const ClientInfo &ci) const;
+  void pack_idlelog(PacketBuffer &buffer, const ClientInfo &ci, int num_intervals) const;
   void unpack_idlelog(PacketBuffer &buffer, ClientInfo &ci, time_t &pack_time, int &num_intervals) const;
   void unlink_idlelog(PacketBuffer &buffer) const;
+  void unpack_legacy_idlelog(PacketBuffer &buffer, ClientInfo &info, time_t pack_time, int num_intervals);
+  void unpack_incremental_idlelog(PacketBuffer &buffer, ClientInfo &info, time_t pack_time);
+
+  void update_timeline();
 
   void save_index();
   void load_index();
@@ -0,0 +1,115 @@
+// InputEventRing.cc --- Queue of input events between two threads
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "InputEventRing.hh"
+
+//! Constructs an empty queue.
+InputEventRing::InputEventRing()
+  : head(0),
+    tail(0),
+    wakeup_requested(0),
+    pushed_count(0),
+    dropped_count(0)
+{
+}
+
+
+//! Queues an event. Must only be called by the producer.
+/*!
+ *  \retval true the event was queued.
+ *  \retval false the queue is full and the event was dropped.
+ */
+bool
+InputEventRing::push(const InputEvent &event)
+{
+  gint h = g_atomic_int_get(&head);
+  gint next = (h + 1) % CAPACITY;
+
+  if (next == g_atomic_int_get(&tail))
+    {
+      g_atomic_int_inc(&dropped_count);
+      return false;
+    }
+
+  events[h] = event;
+
+  // Publish the event after it has been written.
+  g_atomic_int_set(&head, next);
+  g_atomic_int_inc(&pushed_count);
+  return true;
+}
+
+
+//! Returns whether the consumer requested a wakeup, and clears the request.
+bool
+InputEventRing::take_wakeup_request()
+{
+  return g_atomic_int_compare_and_exchange(&wakeup_requested, 1, 0);
+}
+
+
+//! Removes up to max_events events. Must only be called by the consumer.
+/*!
+ *  \return the number of events stored in out.
+ */
+int
+InputEventRing::pop(InputEvent *out, int max_events)
+{
+  gint t = g_atomic_int_get(&tail);
+  gint h = g_atomic_int_get(&head);
+  int count = 0;
+
+  while (t != h && count < max_events)
+    {
+      out[count++] = events[t];
+      t = (t + 1) % CAPACITY;
+    }
+
+  // Release the slots after they have been read.
+  g_atomic_int_set(&tail, t);
+  return count;
+}
+
+
+//! Requests that the producer reports the next event immediately.
+void
+InputEventRing::request_wakeup()
+{
+  g_atomic_int_set(&wakeup_requested, 1);
+}
+
+
+//! Returns the total number of queued events.
+int
+InputEventRing::get_pushed_count()
+{
+  return g_atomic_int_get(&pushed_count);
+}
+
+
+//! Returns the total number of events that were dropped because the queue was full.
+int
+InputEventRing::get_dropped_count()
+{
+  return g_atomic_int_get(&dropped_count);
+}
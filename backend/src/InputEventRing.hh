@@ -0,0 +1,114 @@
+// InputEventRing.hh --- Queue of input events between two threads
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INPUTEVENTRING_HH
+#define INPUTEVENTRING_HH
+
+#include <glib.h>
+
+//! Type of an input event.
+enum InputEventType
+  {
+    //! Generic user activity (if no details info is available)
+    INPUT_EVENT_ACTION,
+
+    //! Mouse movement.
+    INPUT_EVENT_MOUSE,
+
+    //! Mouse button press or release.
+    INPUT_EVENT_BUTTON,
+
+    //! Key press.
+    INPUT_EVENT_KEYBOARD,
+  };
+
+
+//! A single input event.
+struct InputEvent
+{
+  //! Type of the event.
+  guint8 type;
+
+  //! Button is pressed (INPUT_EVENT_BUTTON) or key is repeated (INPUT_EVENT_KEYBOARD).
+  guint8 flag;
+
+  //! Mouse wheel delta.
+  gint16 wheel;
+
+  //! Mouse X coordinate.
+  gint32 x;
+
+  //! Mouse Y coordinate.
+  gint32 y;
+
+  //! Time at which the event occurred.
+  GTimeVal time;
+};
+
+
+//! Bounded single-producer/single-consumer queue of input events.
+/*!
+ *  The thread of the input monitor pushes events, the main thread pops
+ *  them in batches. Neither side takes a lock. When the queue is full,
+ *  new events are dropped and counted.
+ */
+class InputEventRing
+{
+public:
+  //! Maximum number of queued events.
+  /*! The queue is drained every heartbeat, which limits the input rate to
+   *  CAPACITY - 1 events per second.
+   */
+  static const int CAPACITY = 4096;
+
+  InputEventRing();
+
+  // Producer
+  bool push(const InputEvent &event);
+  bool take_wakeup_request();
+
+  // Consumer
+  int pop(InputEvent *out, int max_events);
+  void request_wakeup();
+
+  // Statistics
+  int get_pushed_count();
+  int get_dropped_count();
+
+private:
+  //! The events.
+  InputEvent events[CAPACITY];
+
+  //! Next slot to write. Only modified by the producer.
+  volatile gint head;
+
+  //! Next slot to read. Only modified by the consumer.
+  volatile gint tail;
+
+  //! Does the consumer want to be notified of the next event?
+  volatile gint wakeup_requested;
+
+  //! Total number of queued events.
+  volatile gint pushed_count;
+
+  //! Total number of dropped events.
+  volatile gint dropped_count;
+};
+
+#endif // INPUTEVENTRING_HH
@@ -25,6 +25,9 @@
 
 #include "InputMonitor.hh"
 
+//! Maximum number of events delivered to the listeners at once.
+static const int MAX_BATCH_SIZE = 256;
+
 
 InputMonitor::InputMonitor()
   : activity_listener(NULL),
@@ -70,3 +73,32 @@ InputMonitor::unsubscribe_statistics(IInputMonitorListener *listener)
   assert(statistics_listener != NULL);
   statistics_listener = NULL;
 }
+
+
+//! Delivers all queued input events to the listeners.
+void
+InputMonitor::dispatch_events()
+{
+  InputEvent events[MAX_BATCH_SIZE];
+  int count;
+
+  while ((count = ring.pop(events, MAX_BATCH_SIZE)) > 0)
+    {
+      if (activity_listener != NULL)
+        {
+          activity_listener->input_events_notify(events, count);
+        }
+      if (statistics_listener != NULL)
+        {
+          statistics_listener->input_events_notify(events, count);
+        }
+    }
+}
+
+
+//! Requests that the activity listener is woken up by the next input event.
+void
+InputMonitor::request_wakeup()
+{
+  ring.request_wakeup();
+}
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include "IInputMonitor.hh"
 #include "IInputMonitorListener.hh"
+#include "InputEventRing.hh"
 
 // Forward declarion of internal interfaces.
 class IInputMonitorListener;
@@ -40,6 +41,9 @@ public:
   virtual void unsubscribe_activity(IInputMonitorListener *listener);
   virtual void unsubscribe_statistics(IInputMonitorListener *listener);
 
+  virtual void dispatch_events();
+  virtual void request_wakeup();
+
 protected:
   void fire_action();
   void fire_mouse(int x, int y, int wheel = 0);
@@ -47,6 +51,12 @@ protected:
   void fire_keyboard(bool repeat);
 
 private:
+  void fire_event(InputEventType type, bool flag = false, int x = 0, int y = 0, int wheel = 0);
+
+private:
+  //! Events queued by the monitor thread.
+  InputEventRing ring;
+
   //!
   IInputMonitorListener *activity_listener;
 
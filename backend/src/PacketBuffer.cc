@@ -43,28 +43,46 @@ PacketBuffer::PacketBuffer() :
 PacketBuffer::~PacketBuffer()
 {
   narrow(0, -1);
-  if (buffer != NULL)
+  free_buffer(buffer, buffer_size);
+}
+
+
+//! Allocates storage from the slice allocator.
+/*!
+ *  The slice allocator keeps pools of recently released buffers of each
+ *  size, so that the buffer of a large packet can be reused for the next
+ *  packet of similar size.
+ */
+guint8 *
+PacketBuffer::alloc_buffer(int size)
+{
+  return (guint8 *) g_slice_alloc(size);
+}
+
+
+//! Releases storage allocated by alloc_buffer.
+void
+PacketBuffer::free_buffer(guint8 *data, int size)
+{
+  if (data != NULL)
     {
-      g_free(buffer);
+      g_slice_free1(size, data);
     }
 }
 
+
 void
 PacketBuffer::create(int size)
 {
   narrow(0, -1);
-
-  if (buffer != NULL)
-    {
-      g_free(buffer);
-    }
+  free_buffer(buffer, buffer_size);
 
   if (size == 0)
     {
-      size = 1024;
+      size = DEFAULT_SIZE;
     }
 
-  buffer = g_new(guint8, size);
+  buffer = alloc_buffer(size);
   read_ptr = buffer;
   write_ptr = buffer;
   buffer_size = size;
@@ -79,7 +97,7 @@ PacketBuffer::resize(int size)
 
   if (size == 0)
     {
-      size = 1024;
+      size = DEFAULT_SIZE;
     }
 
   if (size != buffer_size && buffer != NULL)
@@ -99,7 +117,11 @@ PacketBuffer::resize(int size)
 
       //TRACE_MSG(read_offset << " " << write_offset);
 
-      buffer = g_renew(guint8, buffer, size);
+      // Slices cannot be reallocated in place.
+      guint8 *new_buffer = alloc_buffer(size);
+      memcpy(new_buffer, buffer, MIN(size, buffer_size));
+      free_buffer(buffer, buffer_size);
+      buffer = new_buffer;
 
       //TRACE_MSG(buffer);
 
@@ -252,6 +274,32 @@ PacketBuffer::pack_byte(guint8 data)
 }
 
 
+//! Packs an unsigned value in 7 bit groups, least significant first.
+void
+PacketBuffer::pack_varint(guint32 data)
+{
+  if (write_ptr + 5 >= buffer + buffer_size)
+    {
+      grow(5);
+    }
+
+  while (data >= 0x80)
+    {
+      *write_ptr++ = (guint8)((data & 0x7f) | 0x80);
+      data >>= 7;
+    }
+  *write_ptr++ = (guint8)data;
+}
+
+
+//! Packs a signed value as a zigzag encoded varint.
+void
+PacketBuffer::pack_svarint(gint32 data)
+{
+  pack_varint(((guint32)data << 1) ^ (guint32)(data >> 31));
+}
+
+
 void
 PacketBuffer::poke_byte(int pos, guint8 data)
 {
@@ -399,6 +447,36 @@ PacketBuffer::unpack_byte()
 }
 
 
+guint32
+PacketBuffer::unpack_varint()
+{
+  guint32 ret = 0;
+  int shift = 0;
+
+  while (read_ptr < write_ptr && shift < 35)
+    {
+      guint8 b = *read_ptr++;
+      ret |= (guint32)(b & 0x7f) << shift;
+      shift += 7;
+
+      if ((b & 0x80) == 0)
+        {
+          break;
+        }
+    }
+
+  return ret;
+}
+
+
+gint32
+PacketBuffer::unpack_svarint()
+{
+  guint32 v = unpack_varint();
+  return (gint32)((v >> 1) ^ (0 - (v & 1)));
+}
+
+
 int
 PacketBuffer::peek(int pos, guint8 **data)
 {
@@ -491,10 +569,35 @@ PacketBuffer::reserve_size(int &pos)
 }
 
 
+//! Writes the size of the data packed since reserve_size.
+/*!
+ *  A size of LONG_SIZE or more is written in long form: LONG_SIZE followed
+ *  by the 32 bit size. The data is moved to make room for it.
+ */
 void
 PacketBuffer::update_size(int pos)
 {
-  poke_ushort(pos, bytes_written() - pos - 2);
+  int size = bytes_written() - pos - 2;
+  if (size < LONG_SIZE)
+    {
+      poke_ushort(pos, size);
+      return;
+    }
+
+  if (write_ptr + 4 >= buffer + buffer_size)
+    {
+      grow(4);
+    }
+
+  guint8 *data = buffer + pos + 2;
+  memmove(data + 4, data, size);
+  write_ptr += 4;
+
+  poke_ushort(pos, LONG_SIZE);
+  data[0] = ((size & 0xff000000) >> 24);
+  data[1] = ((size & 0x00ff0000) >> 16);
+  data[2] = ((size & 0x0000ff00) >> 8);
+  data[3] = ((size & 0x000000ff));
 }
 
 
@@ -503,6 +606,14 @@ PacketBuffer::read_size(int &pos)
 {
   int size = unpack_ushort();
 
+  if (size == LONG_SIZE)
+    {
+      guint32 long_size = unpack_ulong();
+
+      // A size beyond the end of the data makes the caller see truncated data.
+      size = long_size > (guint32) bytes_available() ? bytes_available() + 1 : (int) long_size;
+    }
+
   pos = bytes_read() + size;
 
   return size;
@@ -517,20 +628,6 @@ PacketBuffer::skip_size(int &pos)
 }
 
 
-void
-PacketBuffer::insert(int pos, int size)
-{
-  if (pos < bytes_written())
-    {
-      int move = bytes_written() - pos;
-
-      memmove(buffer + pos + size, buffer + pos, move);
-
-      write_ptr += size;
-    }
-}
-
-
 void
 PacketBuffer::narrow(int pos, int size)
 {
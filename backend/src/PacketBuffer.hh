@@ -40,7 +40,6 @@ public:
 
   void clear() { narrow(0, -1); write_ptr = read_ptr = buffer; }
   void skip(int size) { read_ptr += size; }
-  void insert(int pos, int size);
 
   void pack(const guint8 *data, int size);
   void pack_raw(const guint8 *data, int size);
@@ -50,6 +49,8 @@ public:
   void pack_ushort(guint16 data);
   void pack_ulong(guint32 data);
   void pack_byte(guint8 data);
+  void pack_varint(guint32 data);
+  void pack_svarint(gint32 data);
 
   void poke_byte(int pos, guint8 data);
   void poke_ushort(int pos, guint16 data);
@@ -61,6 +62,8 @@ public:
   guint32 unpack_ulong();
   guint16 unpack_ushort();
   guint8 unpack_byte();
+  guint32 unpack_varint();
+  gint32 unpack_svarint();
 
   int peek(int pos, guint8 **data);
   gchar *peek_string(int pos);
@@ -81,7 +84,17 @@ public:
   int get_buffer_size() { return buffer_size; }
   void restart_read() { read_ptr = buffer; }
 
+private:
+  static guint8 *alloc_buffer(int size);
+  static void free_buffer(guint8 *data, int size);
+
 public:
+  //! Size of a buffer that is created without an explicit size.
+  static const int DEFAULT_SIZE = 1024;
+
+  //! Size field that announces a 32 bit size.
+  static const int LONG_SIZE = 0xffff;
+
   guint8 *buffer;
   guint8 *read_ptr;
   guint8 *write_ptr;
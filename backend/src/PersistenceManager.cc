@@ -0,0 +1,397 @@
+// PersistenceManager.cc --- Writes files in the background
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#ifdef PLATFORM_OS_WIN32
+#include <windows.h>
+#include <io.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "debug.hh"
+
+#include "PersistenceManager.hh"
+
+using namespace std;
+
+//! Constructor
+PersistenceManager::PersistenceManager()
+  : running(false),
+    busy(false),
+    abort(false),
+    bytes_written(0),
+    write_count(0),
+    skip_count(0),
+    fsync_count(0)
+{
+  writer_thread = new Thread(this);
+  mutex = g_mutex_new();
+  cond = g_cond_new();
+}
+
+
+//! Destructor
+PersistenceManager::~PersistenceManager()
+{
+  terminate();
+
+  delete writer_thread;
+  g_mutex_free(mutex);
+  g_cond_free(cond);
+}
+
+
+//! Starts the writer thread.
+void
+PersistenceManager::init()
+{
+  if (!running)
+    {
+      running = true;
+      writer_thread->start();
+    }
+}
+
+
+//! Writes all pending files and stops the writer thread.
+void
+PersistenceManager::terminate()
+{
+  TRACE_ENTER("PersistenceManager::terminate");
+  if (running)
+    {
+      flush();
+
+      g_mutex_lock(mutex);
+      abort = true;
+      g_cond_broadcast(cond);
+      g_mutex_unlock(mutex);
+
+      writer_thread->wait();
+      running = false;
+
+      TRACE_MSG("bytes = " << bytes_written << " writes = " << write_count
+                << " skipped = " << skip_count << " fsyncs = " << fsync_count);
+    }
+  TRACE_EXIT();
+}
+
+
+//! Replaces the contents of a file.
+void
+PersistenceManager::write_file(const string &filename, const string &contents)
+{
+  forget_failed_writes();
+
+  FileContents::iterator it = contents_cache.find(filename);
+  if (it != contents_cache.end() && it->second == contents)
+    {
+      g_mutex_lock(mutex);
+      skip_count++;
+      g_mutex_unlock(mutex);
+      return;
+    }
+  PendingWrite pending_write;
+  pending_write.replace = true;
+  pending_write.contents = contents;
+
+  if (!running)
+    {
+      if (write(filename, pending_write))
+        {
+          contents_cache[filename] = contents;
+        }
+      else
+        {
+          contents_cache.erase(filename);
+        }
+      return;
+    }
+
+  // A failed write removes the file from the cache again.
+  contents_cache[filename] = contents;
+
+  g_mutex_lock(mutex);
+  pending[filename] = pending_write;
+  g_cond_broadcast(cond);
+  g_mutex_unlock(mutex);
+}
+
+
+//! Appends data to a file.
+void
+PersistenceManager::append_file(const string &filename, const string &contents)
+{
+  forget_failed_writes();
+
+  FileContents::iterator it = contents_cache.find(filename);
+  if (it != contents_cache.end())
+    {
+      it->second += contents;
+    }
+
+  if (!running)
+    {
+      PendingWrite pending_write;
+      pending_write.contents = contents;
+      if (!write(filename, pending_write))
+        {
+          contents_cache.erase(filename);
+        }
+      return;
+    }
+
+  g_mutex_lock(mutex);
+
+  // Appending to a pending write yields a single write.
+  PendingWrite &pending_write = pending[filename];
+  pending_write.contents += contents;
+
+  g_cond_broadcast(cond);
+  g_mutex_unlock(mutex);
+}
+
+
+//! Returns whether an append to the file failed since the last check.
+/*!
+ *  The appended data is lost and the file is left as it was before the
+ *  append; the caller should write the complete file again.
+ */
+bool
+PersistenceManager::check_append_failed(const string &filename)
+{
+  g_mutex_lock(mutex);
+  bool ret = failed_appends.erase(filename) > 0;
+  g_mutex_unlock(mutex);
+  return ret;
+}
+
+
+//! Waits until all pending files are written.
+void
+PersistenceManager::flush()
+{
+  if (running)
+    {
+      g_mutex_lock(mutex);
+      while (!pending.empty() || busy)
+        {
+          g_cond_wait(cond, mutex);
+        }
+      g_mutex_unlock(mutex);
+    }
+}
+
+
+gint64
+PersistenceManager::get_bytes_written()
+{
+  g_mutex_lock(mutex);
+  gint64 ret = bytes_written;
+  g_mutex_unlock(mutex);
+  return ret;
+}
+
+
+int
+PersistenceManager::get_write_count()
+{
+  g_mutex_lock(mutex);
+  int ret = write_count;
+  g_mutex_unlock(mutex);
+  return ret;
+}
+
+
+int
+PersistenceManager::get_skip_count()
+{
+  g_mutex_lock(mutex);
+  int ret = skip_count;
+  g_mutex_unlock(mutex);
+  return ret;
+}
+
+
+int
+PersistenceManager::get_fsync_count()
+{
+  g_mutex_lock(mutex);
+  int ret = fsync_count;
+  g_mutex_unlock(mutex);
+  return ret;
+}
+
+
+//! The writer thread.
+void
+PersistenceManager::run()
+{
+  TRACE_ENTER("PersistenceManager::run");
+
+  g_mutex_lock(mutex);
+  while (true)
+    {
+      while (pending.empty() && !abort)
+        {
+          g_cond_wait(cond, mutex);
+        }
+
+      if (pending.empty())
+        {
+          break;
+        }
+
+      PendingWrites work;
+      work.swap(pending);
+      busy = true;
+      g_mutex_unlock(mutex);
+
+      for (PendingWrites::const_iterator i = work.begin(); i != work.end(); i++)
+        {
+          write(i->first, i->second);
+        }
+
+      g_mutex_lock(mutex);
+      busy = false;
+      g_cond_broadcast(cond);
+    }
+  g_mutex_unlock(mutex);
+
+  TRACE_EXIT();
+}
+
+
+//! Performs a single write.
+bool
+PersistenceManager::write(const string &filename, const PendingWrite &pending_write)
+{
+  TRACE_ENTER_MSG("PersistenceManager::write", filename << " " << pending_write.contents.size());
+
+  string target = pending_write.replace ? filename + ".tmp" : filename;
+
+  FILE *file = fopen(target.c_str(), pending_write.replace ? "wb" : "ab");
+  bool ok = (file != NULL);
+
+  if (ok)
+    {
+      long size = 0;
+      if (!pending_write.replace)
+        {
+          ok = fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0;
+        }
+
+      ok = ok && fwrite(pending_write.contents.data(), 1, pending_write.contents.size(), file) == pending_write.contents.size();
+
+      if (!ok && !pending_write.replace && size >= 0)
+        {
+          // Do not leave a partial record behind.
+          fflush(file);
+#ifdef PLATFORM_OS_WIN32
+          _chsize(_fileno(file), size);
+#else
+          (void) ftruncate(fileno(file), size);
+#endif
+        }
+
+      ok = sync_and_close(file) && ok;
+    }
+
+  if (ok && pending_write.replace)
+    {
+#ifdef PLATFORM_OS_WIN32
+      ok = MoveFileExA(target.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+      ok = rename(target.c_str(), filename.c_str()) == 0;
+#endif
+    }
+
+  g_mutex_lock(mutex);
+  if (ok)
+    {
+      bytes_written += pending_write.contents.size();
+      write_count++;
+    }
+  else
+    {
+      failed_files.insert(filename);
+      if (!pending_write.replace)
+        {
+          failed_appends.insert(filename);
+        }
+    }
+  g_mutex_unlock(mutex);
+
+  if (!ok && pending_write.replace)
+    {
+      remove(target.c_str());
+    }
+
+  TRACE_RETURN(ok);
+  return ok;
+}
+
+
+//! Removes the files whose write failed from the contents cache, so that they are written again.
+void
+PersistenceManager::forget_failed_writes()
+{
+  g_mutex_lock(mutex);
+  FileNames failed;
+  failed.swap(failed_files);
+  g_mutex_unlock(mutex);
+
+  for (FileNames::const_iterator i = failed.begin(); i != failed.end(); i++)
+    {
+      contents_cache.erase(*i);
+    }
+}
+
+
+//! Flushes the file to disk and closes it.
+bool
+PersistenceManager::sync_and_close(FILE *file)
+{
+  bool ok = fflush(file) == 0;
+  if (ok)
+    {
+#ifdef PLATFORM_OS_WIN32
+      ok = _commit(_fileno(file)) == 0;
+#else
+      ok = fsync(fileno(file)) == 0;
+#endif
+    }
+
+  if (ok)
+    {
+      g_mutex_lock(mutex);
+      fsync_count++;
+      g_mutex_unlock(mutex);
+    }
+
+  return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,127 @@
+// PersistenceManager.hh --- Writes files in the background
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PERSISTENCEMANAGER_HH
+#define PERSISTENCEMANAGER_HH
+
+#include <stdio.h>
+#include <string>
+#include <map>
+#include <set>
+
+#include <glib.h>
+
+#include "Runnable.hh"
+#include "Thread.hh"
+
+//! Writes files from a background thread.
+/*!
+ *  Files are handed over from the main thread and written later, so
+ *  that slow storage does not block the main thread. Pending writes of
+ *  the same file are coalesced; only the last contents are written.
+ *  Files are replaced atomically by writing a temporary file and renaming
+ *  it. Files whose contents did not change are not written at all.
+ */
+class PersistenceManager : public Runnable
+{
+public:
+  PersistenceManager();
+  virtual ~PersistenceManager();
+
+  void init();
+  void terminate();
+
+  void write_file(const std::string &filename, const std::string &contents);
+  void append_file(const std::string &filename, const std::string &contents);
+  bool check_append_failed(const std::string &filename);
+  void flush();
+
+  gint64 get_bytes_written();
+  int get_write_count();
+  int get_skip_count();
+  int get_fsync_count();
+
+private:
+  //! A pending write of a single file.
+  struct PendingWrite
+  {
+    PendingWrite() : replace(false) {}
+
+    //! Replace the file (true) or append to it (false).
+    bool replace;
+
+    //! Data to write.
+    std::string contents;
+  };
+
+  typedef std::map<std::string, PendingWrite> PendingWrites;
+  typedef std::map<std::string, std::string> FileContents;
+  typedef std::set<std::string> FileNames;
+
+  virtual void run();
+
+  bool write(const std::string &filename, const PendingWrite &pending_write);
+  bool sync_and_close(FILE *file);
+  void forget_failed_writes();
+
+private:
+  //! Writes that have not been started yet. Protected by mutex.
+  PendingWrites pending;
+
+  //! Last contents handed over for each file. Only used by the main thread.
+  FileContents contents_cache;
+
+  //! Files whose last write failed. Protected by mutex.
+  FileNames failed_files;
+
+  //! Files to which an append failed since the last check. Protected by mutex.
+  FileNames failed_appends;
+
+  //! The thread that writes the files.
+  Thread *writer_thread;
+
+  //! Is the writer thread running?
+  bool running;
+
+  //! Is the writer thread writing? Protected by mutex.
+  bool busy;
+
+  //! Stop the writer thread. Protected by mutex.
+  bool abort;
+
+  //! Protects the pending writes and the counters.
+  GMutex *mutex;
+
+  //! Signalled when writes are pending or finished.
+  GCond *cond;
+
+  //! Total number of bytes written.
+  gint64 bytes_written;
+
+  //! Total number of files written.
+  int write_count;
+
+  //! Total number of writes skipped because nothing changed.
+  int skip_count;
+
+  //! Total number of files synced to disk.
+  int fsync_count;
+};
+
+#endif // PERSISTENCEMANAGER_HH
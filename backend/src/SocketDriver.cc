@@ -24,8 +24,15 @@ static const char rcsid[] = "$Id: GNetSocketDriver.cc 1184 2007-05-12 09:16:31Z
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "SocketDriver.hh"
 
+#if defined(HAVE_SYS_EPOLL_H)
+#include "EpollSocketDriver.hh"
+#endif
+
 #if defined(HAVE_GIO_NET)
 #include "GIOSocketDriver.hh"
 #endif
@@ -38,6 +45,15 @@ static const char rcsid[] = "$Id: GNetSocketDriver.cc 1184 2007-05-12 09:16:31Z
 SocketDriver *
 SocketDriver::create()
 {
+#if defined(HAVE_SYS_EPOLL_H)
+  // Headless hubs with many peers may select the epoll driver.
+  const char *driver = getenv("WORKRAVE_SOCKET_DRIVER");
+  if (driver != NULL && strcmp(driver, "epoll") == 0)
+    {
+      return new EpollSocketDriver();
+    }
+#endif
+
 #if defined(HAVE_GIO_NET)
   return new GIOSocketDriver();
 #elif defined(HAVE_GNET)
@@ -47,3 +63,29 @@ SocketDriver::create()
 #endif
 }
 
+
+//! Multicast is not supported by default.
+IMulticastSocket *
+SocketDriver::create_multicast_socket()
+{
+  return NULL;
+}
+
+
+//! Writes the segments one at a time.
+void
+ISocket::write_vector(const SocketVector *vec, int count, int &bytes_written)
+{
+  bytes_written = 0;
+  for (int i = 0; i < count; i++)
+    {
+      int segment_written = 0;
+      write((void *)vec[i].buf, vec[i].count, segment_written);
+      bytes_written += segment_written;
+
+      if (segment_written != vec[i].count)
+        {
+          break;
+        }
+    }
+}
@@ -22,6 +22,7 @@
 
 class ISocket;
 class ISocketServer;
+class IMulticastSocket;
 
 #include "Exception.hh"
 
@@ -40,6 +41,9 @@ public:
   //! The specified socket has data ready to be read.
   virtual void socket_io(ISocket *con, void *data) = 0;
 
+  //! The specified socket can accept more data.
+  virtual void socket_writable(ISocket *con, void *data) = 0;
+
   //! The specified socket closed its connection.
   virtual void socket_closed(ISocket *con, void *data) = 0;
 };
@@ -57,6 +61,30 @@ public:
 };
 
 
+//! Asynchronous multicast socket callbacks.
+class IMulticastSocketListener
+{
+public:
+  IMulticastSocketListener() {}
+  virtual ~IMulticastSocketListener() {}
+
+  //! The specified socket received a datagram from the specified host.
+  virtual void multicast_received(IMulticastSocket *con, const std::string &host,
+                                  const void *buf, int count) = 0;
+};
+
+
+//! A segment of data to write.
+struct SocketVector
+{
+  //! Start of the segment.
+  const void *buf;
+
+  //! Number of bytes in the segment.
+  int count;
+};
+
+
 //! TCP Socket.
 class ISocket
 {
@@ -75,8 +103,17 @@ public:
   virtual void read(void *buf, int count, int &bytes_read) = 0;
 
   //! Write data to the connection
+  /*! Does not block. Fewer bytes than requested are written if the
+   *  connection cannot accept more data.
+   */
   virtual void write(void *buf, int count, int &bytes_written) = 0;
 
+  //! Write a sequence of segments to the connection
+  virtual void write_vector(const SocketVector *vec, int count, int &bytes_written);
+
+  //! Enable/Disable notifications when the socket can accept more data.
+  virtual void set_notify_writable(bool enabled) = 0;
+
   //! Close the connection.
   virtual void close() = 0;
 
@@ -120,6 +157,35 @@ protected:
 };
 
 
+//! UDP multicast socket.
+class IMulticastSocket
+{
+public:
+  IMulticastSocket() :
+    listener(NULL)
+  {
+  }
+
+  virtual ~IMulticastSocket() {};
+
+  //! Join the multicast group at the specified port.
+  /*! Datagrams sent to the group, including our own, are received. Several
+   *  processes on the same host may join the same group and port.
+   */
+  virtual void join(const std::string &group, int port) = 0;
+
+  //! Send a datagram to the group.
+  virtual void send(const void *buf, int count) = 0;
+
+  //! Sets the callback listener for asynchronous events.
+  void set_listener(IMulticastSocketListener *l);
+
+protected:
+  //! Listener that receives the datagrams.
+  IMulticastSocketListener *listener;
+};
+
+
 //! TCP Socket abstraction.
 class SocketDriver
 {
@@ -133,6 +199,9 @@ public:
 
   //! Create a new listen socket
   virtual ISocketServer *create_server() = 0;
+
+  //! Create a new multicast socket, or NULL if the driver does not support multicast.
+  virtual IMulticastSocket *create_multicast_socket();
 };
 
 
@@ -29,17 +29,20 @@
 #include <sstream>
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
 
 #include "debug.hh"
 
 #include "Statistics.hh"
 
 #include "Core.hh"
+#include "PersistenceManager.hh"
 #include "Util.hh"
 #include "Timer.hh"
 #include "TimePred.hh"
 #include "InputMonitorFactory.hh"
 #include "IInputMonitor.hh"
+#include "InputEventRing.hh"
 #include "timeutil.h"
 
 #ifdef HAVE_DISTRIBUTION
@@ -50,12 +53,28 @@ const char *WORKRAVESTATS="WorkRaveStats";
 const int STATSVERSION = 4;
 
 #define MAX_JUMP (10000)
+#define HISTORY_BATCH_SIZE (16)
+
+//! Returns the size of the specified file, or -1 if it does not exist.
+static gint64
+get_file_size(const string &filename)
+{
+  ifstream file(filename.c_str(), ios::in | ios::binary);
+  if (!file.good())
+    {
+      return -1;
+    }
+
+  file.seekg(0, ios::end);
+  return (gint64) file.tellg();
+}
 
 //! Constructor
 Statistics::Statistics() :
   core(NULL),
   current_day(NULL),
   been_active(false),
+  first_day_number(0),
   prev_x(-1),
   prev_y(-1),
   click_x(-1),
@@ -154,8 +173,16 @@ Statistics::delete_all_history()
             ;
 
         history.clear();
+        day_totals.clear();
+    }
+
+    if( !history_store.remove() )
+    {
+        return false;
     }
 
+    core->get_persistence_manager()->flush();
+
     string todayfile = Util::get_home_directory() + "todaystats";
     if( Util::file_exists( todayfile.c_str() ) && std::remove( todayfile.c_str() ) )
     {
@@ -231,24 +258,35 @@ Statistics::day_to_history(DailyStatsImpl *stats)
   save_day(stats, stats_file);
   stats_file.close();
 
+  gint64 text_size = get_file_size(ss.str().c_str());
+  if (!history_store.write_day(*stats, text_size))
+    {
+      save_history(text_size);
+    }
 }
 
 
-//! Adds the current day to this history.
+//! Tells the other clients that a day was added to the history of the master.
+/*!
+ *  Only the day number is broadcast. Clients that do not have the day
+ *  request it, together with any other day they missed.
+ */
 void
 Statistics::day_to_remote_history(DailyStatsImpl *stats)
 {
 #ifdef HAVE_DISTRIBUTION
   DistributionManager *dist_manager = core->get_distribution_manager();
 
-  if (dist_manager != NULL)
+  if (dist_manager != NULL && dist_manager->is_master())
     {
       PacketBuffer state_packet;
       state_packet.create();
 
-      state_packet.pack_byte(STATS_MARKER_HISTORY);
-      pack_stats(state_packet, stats);
-      state_packet.pack_byte(STATS_MARKER_END);
+      int pos = 0;
+      state_packet.pack_byte(STATS_MARKER_HISTORY_NOTICE);
+      state_packet.reserve_size(pos);
+      state_packet.pack_ulong(stats->get_day_number());
+      state_packet.update_size(pos);
 
       dist_manager->broadcast_client_message(DCM_STATS, state_packet);
     }
@@ -260,7 +298,7 @@ Statistics::day_to_remote_history(DailyStatsImpl *stats)
 
 //! Saves the current day to the specified stream.
 void
-Statistics::save_day(DailyStatsImpl *stats, ofstream &stats_file)
+Statistics::save_day(DailyStatsImpl *stats, ostream &stats_file)
 {
   stats_file << "D "
              << stats->start.tm_mday << " "
@@ -292,8 +330,6 @@ Statistics::save_day(DailyStatsImpl *stats, ofstream &stats_file)
       stats_file << stats->misc_stats[j] << " ";
     }
   stats_file << endl;
-
-  stats_file.close();
 }
 
 
@@ -301,71 +337,126 @@ Statistics::save_day(DailyStatsImpl *stats, ofstream &stats_file)
 void
 Statistics::save_day(DailyStatsImpl *stats)
 {
-  stringstream ss;
-  ss << Util::get_home_directory();
-  ss << "todaystats" << ends;
-
-  ofstream stats_file(ss.str().c_str());
+  stringstream stats_file;
 
   stats_file << WORKRAVESTATS << " " << STATSVERSION  << endl;
 
   save_day(stats, stats_file);
+
+  core->get_persistence_manager()->write_file(Util::get_home_directory() + "todaystats", stats_file.str());
 }
 
 
 //! Add the stats the the history list.
+/*!
+ *  The stats replace the stats of the same day, if any.
+ */
 void
 Statistics::add_history(DailyStatsImpl *stats)
 {
-  if (history.size() == 0)
+  int day = stats->get_day_number();
+  int pos = count_days_until(day - 1);
+
+  if (count_days_until(day) > pos)
     {
-      history.push_back(stats);
+      delete history[pos];
+      history[pos] = stats;
     }
   else
     {
-      bool found = false;
-      HistoryRIter i = history.rbegin();
-      while (i != history.rend())
+      history.insert(history.begin() + pos, stats);
+    }
+
+  update_day_totals(pos);
+}
+
+
+//! Recomputes the running totals from the specified history position onwards.
+/*!
+ *  Adding the newest day only costs the number of days since the previous
+ *  day. Changing an older day recomputes the totals of all later days.
+ */
+void
+Statistics::update_day_totals(int pos)
+{
+  if (pos <= 0 || day_totals.empty())
+    {
+      pos = 0;
+      day_totals.clear();
+      if (!history.empty())
         {
-          DailyStatsImpl *ref = *i;
+          first_day_number = history[0]->get_day_number();
+        }
+    }
+  else
+    {
+      // Continue from the totals of the previous day; the loop pads any gap.
+      day_totals.resize(history[pos - 1]->get_day_number() - first_day_number + 1);
+    }
+
+  RangeStats totals;
+  if (day_totals.empty())
+    {
+      memset(&totals, 0, sizeof(totals));
+    }
+  else
+    {
+      totals = day_totals.back();
+    }
 
-          if (stats->start.tm_year == ref->start.tm_year  &&
-              stats->start.tm_mon == ref->start.tm_mon &&
-              stats->start.tm_mday == ref->start.tm_mday)
+  for (int i = pos; i < int(history.size()); i++)
+    {
+      const DailyStatsImpl *stats = history[i];
+      int index = stats->get_day_number() - first_day_number;
+
+      // Days without statistics.
+      day_totals.resize(index, totals);
+
+      totals.day_count++;
+      for (int b = 0; b < BREAK_ID_SIZEOF; b++)
+        {
+          for (int j = 0; j < STATS_BREAKVALUE_SIZEOF; j++)
             {
-              delete *i;
-              *i = stats;
-              found = true;
-              break;
+              totals.break_stats[b][j] += stats->break_stats[b][j];
             }
-
-          else if ( stats->start.tm_year > ref->start.tm_year
-                    || (stats->start.tm_year == ref->start.tm_year
-                        && (stats->start.tm_mon > ref->start.tm_mon
-                            || (stats->start.tm_mon == ref->start.tm_mon
-                                && stats->start.tm_mday > ref->start.tm_mday))))
-          {
-            if (i == history.rbegin())
-              {
-                history.push_back(stats);
-              }
-            else
-              {
-                history.insert(i.base(), stats);
-              }
-            found = true;
-            break;
-          }
-          i++;
         }
-
-      if (!found)
+      for (int j = 0; j < STATS_VALUE_SIZEOF; j++)
         {
-          history.insert(history.begin(), stats);
+          totals.misc_stats[j] += stats->misc_stats[j];
         }
+
+      day_totals.push_back(totals);
     }
 }
 
+
+//! Returns the day number of the newest day in the history, or 0 if the history is empty.
+int
+Statistics::get_newest_day_number() const
+{
+  return history.empty() ? 0 : history.back()->get_day_number();
+}
+
+
+//! Returns the number of days in the history up to and including the specified day.
+int
+Statistics::count_days_until(int day) const
+{
+  if (day_totals.empty() || day < first_day_number)
+    {
+      return 0;
+    }
+
+  int index = day - first_day_number;
+  if (index >= int(day_totals.size()))
+    {
+      return history.size();
+    }
+
+  return day_totals[index].day_count;
+}
+
+
 //! Load the statistics of the current day.
 bool
 Statistics::load_current_day()
@@ -387,22 +478,66 @@ Statistics::load_current_day()
 
 
 //! Loads the history.
+/*!
+ *  The history is read from the binary history file. The text history is
+ *  only parsed when the binary file does not exist yet, or when the text
+ *  history was modified by a version that does not know the binary file.
+ */
 void
 Statistics::load_history()
 {
   TRACE_ENTER("Statistics::load_history");
 
-  stringstream ss;
-  ss << Util::get_home_directory();
-  ss << "historystats" << ends;
+  string text_file = Util::get_home_directory() + "historystats";
+  gint64 text_size = get_file_size(text_file);
 
-  ifstream stats_file(ss.str().c_str());
+  history_store.init(Util::get_home_directory() + "historystats.bin");
+
+  if (history_store.open(text_size))
+    {
+      int count = history_store.get_day_count();
+      history.reserve(count);
+
+      for (int i = 0; i < count; i++)
+        {
+          DailyStatsImpl *stats = new DailyStatsImpl();
+          if (history_store.get_day(i, *stats))
+            {
+              history.push_back(stats);
+            }
+          else
+            {
+              delete stats;
+            }
+        }
+
+      history_store.close();
+      update_day_totals(0);
+    }
+  else
+    {
+      TRACE_MSG("Converting text history");
+      ifstream stats_file(text_file.c_str());
+
+      load(stats_file, true);
+      stats_file.close();
+
+      save_history(text_size);
+    }
 
-  load(stats_file, true);
   TRACE_EXIT();
 }
 
 
+//! Rewrites the binary history file.
+void
+Statistics::save_history(gint64 source_size)
+{
+  vector<DailyStats *> days(history.begin(), history.end());
+  history_store.write_all(days, source_size);
+}
+
+
 //! Loads the statistics.
 void
 Statistics::load(ifstream &infile, bool history)
@@ -671,34 +806,44 @@ Statistics::get_day_index_by_date(int y, int m, int d,
                                   int &idx, int &next, int &prev) const
 {
   TRACE_ENTER_MSG("Statistics::get_day_by_date", y << "/" << m << "/" << d);
+
+  int day = HistoryStore::get_day_number(y, m, d);
+  int today = current_day->get_day_number();
+  int size = history.size();
+
+  // Positions in the history of the first day on or after, and after the date.
+  int first_on_or_after = count_days_until(day - 1);
+  int first_after = count_days_until(day);
+
   idx = next = prev = -1;
-  for (int i = 0; i <= int(history.size()); i++)
+
+  if (first_after > first_on_or_after)
     {
-      int j = history.size() - i;
-      DailyStatsImpl *stats = j == 0 ? current_day : history[i];
-      if (idx < 0 && stats->starts_at_date(y, m, d))
-        {
-          idx = j;
-        }
-      else if (stats->starts_before_date(y, m, d))
-        {
-          prev = j;
-        }
-      else if (next < 0)
-        {
-          next = j;
-        }
+      idx = size - first_on_or_after;
+    }
+  else if (today == day)
+    {
+      idx = 0;
     }
 
-  if (prev < 0 && current_day->starts_before_date(y, m, d))
+  if (today < day)
     {
       prev = 0;
     }
-  if (next < 0 && !current_day->starts_at_date(y, m, d)
-      && !current_day->starts_before_date(y, m, d))
+  else if (first_on_or_after > 0)
+    {
+      prev = size - first_on_or_after + 1;
+    }
+
+  if (first_after < size)
+    {
+      next = size - first_after;
+    }
+  else if (today > day)
     {
       next = 0;
     }
+
   TRACE_EXIT();
 }
 
@@ -710,6 +855,112 @@ Statistics::get_history_size() const
 }
 
 
+//! Returns the totals of all days from y1/m1/d1 up to and including y2/m2/d2.
+void
+Statistics::get_range_stats(int y1, int m1, int d1, int y2, int m2, int d2, RangeStats &stats) const
+{
+  get_range_stats(HistoryStore::get_day_number(y1, m1, d1),
+                  HistoryStore::get_day_number(y2, m2, d2),
+                  stats);
+}
+
+
+//! Returns the totals of the week that contains y/m/d.
+void
+Statistics::get_week_stats(int y, int m, int d, int week_start, RangeStats &stats) const
+{
+  int day = HistoryStore::get_day_number(y, m, d);
+
+  // 1 January 1970 was a Thursday.
+  int weekday = ((day + 4) % 7 + 7) % 7;
+  int first = day - (weekday - week_start + 7) % 7;
+
+  get_range_stats(first, first + 6, stats);
+}
+
+
+//! Returns the totals of month m of year y.
+void
+Statistics::get_month_stats(int y, int m, RangeStats &stats) const
+{
+  int first = HistoryStore::get_day_number(y, m, 1);
+  int last = (m == 12) ? HistoryStore::get_day_number(y + 1, 1, 1) : HistoryStore::get_day_number(y, m + 1, 1);
+
+  get_range_stats(first, last - 1, stats);
+}
+
+
+//! Returns the totals of year y.
+void
+Statistics::get_year_stats(int y, RangeStats &stats) const
+{
+  get_range_stats(HistoryStore::get_day_number(y, 1, 1),
+                  HistoryStore::get_day_number(y + 1, 1, 1) - 1,
+                  stats);
+}
+
+
+//! Returns the totals of all days from from_day up to and including to_day.
+void
+Statistics::get_range_stats(int from_day, int to_day, RangeStats &stats) const
+{
+  memset(&stats, 0, sizeof(stats));
+
+  if (to_day < from_day)
+    {
+      return;
+    }
+
+  // The totals of the range are the difference of two running totals.
+  int last = (int)day_totals.size() - 1;
+  int to_index = std::min(to_day - first_day_number, last);
+  int from_index = std::min(from_day - first_day_number - 1, last);
+
+  if (to_index >= 0)
+    {
+      stats = day_totals[to_index];
+      stats.includes_current_day = false;
+
+      if (from_index >= 0)
+        {
+          const RangeStats &before = day_totals[from_index];
+
+          stats.day_count -= before.day_count;
+          for (int b = 0; b < BREAK_ID_SIZEOF; b++)
+            {
+              for (int j = 0; j < STATS_BREAKVALUE_SIZEOF; j++)
+                {
+                  stats.break_stats[b][j] -= before.break_stats[b][j];
+                }
+            }
+          for (int j = 0; j < STATS_VALUE_SIZEOF; j++)
+            {
+              stats.misc_stats[j] -= before.misc_stats[j];
+            }
+        }
+    }
+
+  // The current day is not part of the history.
+  int today = current_day->get_day_number();
+  if (today >= from_day && today <= to_day)
+    {
+      stats.includes_current_day = true;
+      stats.day_count++;
+      for (int b = 0; b < BREAK_ID_SIZEOF; b++)
+        {
+          for (int j = 0; j < STATS_BREAKVALUE_SIZEOF; j++)
+            {
+              stats.break_stats[b][j] += current_day->break_stats[b][j];
+            }
+        }
+      for (int j = 0; j < STATS_VALUE_SIZEOF; j++)
+        {
+          stats.misc_stats[j] += current_day->misc_stats[j];
+        }
+    }
+}
+
+
 
 void
 Statistics::update_current_day(bool active)
@@ -802,7 +1053,7 @@ Statistics::pack_stats(PacketBuffer &buf, const DailyStatsImpl *stats)
 
   for(int i = 0; i < BREAK_ID_SIZEOF; i++)
     {
-      BreakStats &bs = current_day->break_stats[i];
+      const BreakStats &bs = stats->break_stats[i];
 
       buf.pack_byte(STATS_MARKER_BREAK_STATS);
       buf.reserve_size(pos);
@@ -822,7 +1073,7 @@ Statistics::pack_stats(PacketBuffer &buf, const DailyStatsImpl *stats)
 
   for(int j = 0; j < STATS_VALUE_SIZEOF; j++)
     {
-      buf.pack_ulong(current_day->misc_stats[j]);
+      buf.pack_ulong(stats->misc_stats[j]);
     }
   buf.update_size(pos);
 
@@ -830,6 +1081,13 @@ Statistics::pack_stats(PacketBuffer &buf, const DailyStatsImpl *stats)
   return true;
 }
 
+//! Processes statistics received from a remote client.
+/*!
+ *  Only the history is synchronized; the current day of the master is
+ *  ignored. A client requests the days after its newest day from the
+ *  master, which sends them in batches. The client requests the next
+ *  batch once it has stored the previous one.
+ */
 bool
 Statistics::client_message(DistributionClientMessageID id, bool master, const char *client_id,
                            PacketBuffer &buffer)
@@ -838,13 +1096,12 @@ Statistics::client_message(DistributionClientMessageID id, bool master, const ch
 
   (void) id;
   (void) master;
-  (void) client_id;
-
-  return false;
 
+  bool from_master = client_id != NULL && history_master == client_id;
   DailyStatsImpl *stats = NULL;
   int pos = 0;
   bool stats_to_history = false;
+  bool more = false;
 
   while (buffer.bytes_available() > 0)
     {
@@ -853,58 +1110,68 @@ Statistics::client_message(DistributionClientMessageID id, bool master, const ch
       switch (marker)
         {
         case STATS_MARKER_TODAY:
-          stats = current_day;
+          stats = NULL;
           break;
 
         case STATS_MARKER_HISTORY:
-          stats = new DailyStatsImpl();
-          stats_to_history = true;
+          if (stats_to_history)
+            {
+              delete stats;
+            }
+          stats = from_master ? new DailyStatsImpl() : NULL;
+          stats_to_history = from_master;
           break;
 
         case STATS_MARKER_STARTTIME:
           {
-            int size = buffer.unpack_ushort();
-            (void) size;
-
-            stats->start.tm_mday = buffer.unpack_byte();
-            stats->start.tm_mon = buffer.unpack_byte();
-            stats->start.tm_year = buffer.unpack_ushort();
-            stats->start.tm_hour = buffer.unpack_byte();
-            stats->start.tm_min = buffer.unpack_byte();
+            buffer.read_size(pos);
+            if (stats != NULL)
+              {
+                stats->start.tm_mday = buffer.unpack_byte();
+                stats->start.tm_mon = buffer.unpack_byte();
+                stats->start.tm_year = buffer.unpack_ushort();
+                stats->start.tm_hour = buffer.unpack_byte();
+                stats->start.tm_min = buffer.unpack_byte();
+              }
+            buffer.skip_size(pos);
           }
           break;
 
         case STATS_MARKER_STOPTIME:
           {
-            int size = buffer.unpack_ushort();
-            (void) size;
-
-            stats->stop.tm_mday = buffer.unpack_byte();
-            stats->stop.tm_mon = buffer.unpack_byte();
-            stats->stop.tm_year = buffer.unpack_ushort();
-            stats->stop.tm_hour = buffer.unpack_byte();
-            stats->stop.tm_min = buffer.unpack_byte();
+            buffer.read_size(pos);
+            if (stats != NULL)
+              {
+                stats->stop.tm_mday = buffer.unpack_byte();
+                stats->stop.tm_mon = buffer.unpack_byte();
+                stats->stop.tm_year = buffer.unpack_ushort();
+                stats->stop.tm_hour = buffer.unpack_byte();
+                stats->stop.tm_min = buffer.unpack_byte();
+              }
+            buffer.skip_size(pos);
           }
           break;
 
         case STATS_MARKER_BREAK_STATS:
           {
-            int size = buffer.read_size(pos);
+            buffer.read_size(pos);
             int bt = buffer.unpack_byte();
-            (void) size;
 
-            BreakStats &bs = stats->break_stats[bt];
+            if (stats != NULL && bt >= 0 && bt < BREAK_ID_SIZEOF)
+              {
+                BreakStats &bs = stats->break_stats[bt];
 
-            int count = buffer.unpack_ushort();
+                int count = buffer.unpack_ushort();
 
-            if (count > STATS_BREAKVALUE_SIZEOF)
-              {
-                count = STATS_BREAKVALUE_SIZEOF;
-              }
+                if (count > STATS_BREAKVALUE_SIZEOF)
+                  {
+                    count = STATS_BREAKVALUE_SIZEOF;
+                  }
 
-            for(int j = 0; j < count; j++)
-              {
-                bs[j] = buffer.unpack_ulong();
+                for(int j = 0; j < count; j++)
+                  {
+                    bs[j] = buffer.unpack_ulong();
+                  }
               }
 
             buffer.skip_size(pos);
@@ -913,18 +1180,20 @@ Statistics::client_message(DistributionClientMessageID id, bool master, const ch
 
         case STATS_MARKER_MISC_STATS:
           {
-            int size = buffer.read_size(pos);
-            int count = buffer.unpack_ushort();
-            (void) size;
-
-            if (count > STATS_VALUE_SIZEOF)
+            buffer.read_size(pos);
+            if (stats != NULL)
               {
-                count = STATS_VALUE_SIZEOF;
-              }
+                int count = buffer.unpack_ushort();
 
-            for(int j = 0; j < count; j++)
-              {
-                stats->misc_stats[j] = buffer.unpack_ulong();
+                if (count > STATS_VALUE_SIZEOF)
+                  {
+                    count = STATS_VALUE_SIZEOF;
+                  }
+
+                for(int j = 0; j < count; j++)
+                  {
+                    stats->misc_stats[j] = buffer.unpack_ulong();
+                  }
               }
 
             buffer.skip_size(pos);
@@ -935,16 +1204,43 @@ Statistics::client_message(DistributionClientMessageID id, bool master, const ch
           if (stats_to_history)
             {
               TRACE_MSG("Save to history");
-              day_to_history(stats);
+              remote_day_to_history(stats);
               stats_to_history = false;
             }
+          stats = NULL;
+          break;
+
+        case STATS_MARKER_HISTORY_REQUEST:
+          {
+            buffer.read_size(pos);
+            int day = buffer.unpack_ulong();
+            buffer.skip_size(pos);
+
+            if (client_id != NULL && history_master == "")
+              {
+                send_history(client_id, day);
+              }
+          }
+          break;
+
+        case STATS_MARKER_HISTORY_MORE:
+          more = from_master;
+          break;
+
+        case STATS_MARKER_HISTORY_NOTICE:
+          {
+            buffer.read_size(pos);
+            int day = buffer.unpack_ulong();
+            buffer.skip_size(pos);
+
+            more = from_master && day > get_newest_day_number();
+          }
           break;
 
         default:
           {
             TRACE_MSG("Unknown marker");
-            int size = buffer.read_size(pos);
-            (void) size;
+            buffer.read_size(pos);
             buffer.skip_size(pos);
           }
         }
@@ -954,51 +1250,175 @@ Statistics::client_message(DistributionClientMessageID id, bool master, const ch
     {
       // this should not happend. but just to avoid a potential memory leak...
       TRACE_MSG("Save to history");
-      day_to_history(stats);
+      remote_day_to_history(stats);
       stats_to_history = false;
     }
 
+  if (more)
+    {
+      request_history();
+    }
+
   dump();
 
   TRACE_EXIT();
   return true;
 }
 
-#endif
 
-bool
-Statistics::DailyStatsImpl::starts_at_date(int y, int m, int d)
+//! Requests the days after the newest day in the history from the master.
+void
+Statistics::request_history()
+{
+  TRACE_ENTER_MSG("Statistics::request_history", history_master);
+  DistributionManager *dist_manager = core->get_distribution_manager();
+
+  if (dist_manager != NULL && history_master != "")
+    {
+      PacketBuffer buffer;
+      buffer.create();
+
+      int pos = 0;
+      buffer.pack_byte(STATS_MARKER_HISTORY_REQUEST);
+      buffer.reserve_size(pos);
+      buffer.pack_ulong(get_newest_day_number());
+      buffer.update_size(pos);
+
+      dist_manager->unicast_client_message(DCM_STATS, history_master, buffer);
+    }
+  TRACE_EXIT();
+}
+
+
+//! Sends a batch of the days after the specified day to the specified client.
+void
+Statistics::send_history(const std::string &client_id, int day)
 {
-  return (start.tm_year + 1900 == y
-          && start.tm_mon + 1 == m
-          && start.tm_mday == d);
+  TRACE_ENTER_MSG("Statistics::send_history", client_id << " " << day);
+  DistributionManager *dist_manager = core->get_distribution_manager();
+
+  int first = count_days_until(day);
+  int last = MIN(first + HISTORY_BATCH_SIZE, int(history.size()));
+
+  if (dist_manager != NULL && first < last)
+    {
+      PacketBuffer buffer;
+      buffer.create();
+
+      for (int i = first; i < last; i++)
+        {
+          buffer.pack_byte(STATS_MARKER_HISTORY);
+          pack_stats(buffer, history[i]);
+          buffer.pack_byte(STATS_MARKER_END);
+        }
+
+      if (last < int(history.size()))
+        {
+          buffer.pack_byte(STATS_MARKER_HISTORY_MORE);
+        }
+
+      dist_manager->unicast_client_message(DCM_STATS, client_id, buffer);
+    }
+  TRACE_EXIT();
 }
 
-bool
-Statistics::DailyStatsImpl::starts_before_date(int y, int m, int d)
+
+//! Adds a day received from the master to the history, unless the day is already known.
+void
+Statistics::remote_day_to_history(DailyStatsImpl *stats)
 {
-  return (start.tm_year + 1900 < y
-          || (start.tm_year + 1900 == y
-              && (start.tm_mon + 1 < m
-                  || (start.tm_mon + 1 == m
-                      && start.tm_mday < d))));
+  int day = stats->get_day_number();
+
+  if (stats->is_empty() ||
+      count_days_until(day) > count_days_until(day - 1) ||
+      day >= current_day->get_day_number())
+    {
+      TRACE_MSG("Ignoring day " << day);
+      delete stats;
+      return;
+    }
+
+  day_to_history(stats);
 }
 
 
-//! Activity is reported by the input monitor.
+//! Starts synchronizing the history when the master changes.
 void
-Statistics::action_notify()
+Statistics::sync_history()
 {
+  DistributionManager *dist_manager = core->get_distribution_manager();
+
+  if (dist_manager != NULL)
+    {
+      string master_id = dist_manager->is_master() ? "" : dist_manager->get_master_id();
+      if (master_id != history_master)
+        {
+          history_master = master_id;
+          request_history();
+        }
+    }
 }
 
+#endif
 
-//! Mouse activity is reported by the input monitor.
+//! Processes all input events queued by the statistics input monitor.
+/*!
+ *  The statistics may use a different input monitor than the activity
+ *  monitor. If they share one, its queue was already drained.
+ */
 void
-Statistics::mouse_notify(int x, int y, int wheel_delta)
+Statistics::process_events()
 {
-  static const int sensitivity = 3;
+  if (input_monitor != NULL)
+    {
+      input_monitor->dispatch_events();
+    }
+}
+
 
+//! A batch of input events is reported by the input monitor.
+void
+Statistics::input_events_notify(const InputEvent *events, int count)
+{
   lock.lock();
+  for (int i = 0; i < count; i++)
+    {
+      const InputEvent &event = events[i];
+
+      switch (event.type)
+        {
+        case INPUT_EVENT_MOUSE:
+          process_mouse(event.x, event.y, event.wheel, event.time);
+          break;
+
+        case INPUT_EVENT_BUTTON:
+          process_button(event.flag);
+          break;
+
+        case INPUT_EVENT_KEYBOARD:
+          process_keyboard(event.flag);
+          break;
+
+        default:
+          break;
+        }
+    }
+  lock.unlock();
+}
+
+
+//! Wakeups are only requested by the activity monitor.
+void
+Statistics::wakeup_notify()
+{
+}
+
+
+//! Processes mouse movement at the specified time.
+void
+Statistics::process_mouse(int x, int y, int wheel_delta, const GTimeVal &now)
+{
+  static const int sensitivity = 3;
 
   if (current_day != NULL && x >=0 && y >= 0)
     {
@@ -1027,9 +1447,8 @@ Statistics::mouse_notify(int x, int y, int wheel_delta)
               current_day->misc_stats[STATS_VALUE_TOTAL_MOUSE_MOVEMENT] = movement;
             }
 
-          GTimeVal now, tv;
+          GTimeVal tv;
 
-          g_get_current_time(&now);
           tvSUBTIME(tv, now, last_mouse_time);
 
           if (!tvTIMEEQ0(last_mouse_time) && tv.tv_sec < 1 && tv.tv_sec >= 0 && tv.tv_usec >= 0)
@@ -1043,16 +1462,13 @@ Statistics::mouse_notify(int x, int y, int wheel_delta)
           last_mouse_time = now;
         }
     }
-
-  lock.unlock();
 }
 
 
-//! Mouse button activity is reported by the input monitor.
+//! Processes a mouse button press or release.
 void
-Statistics::button_notify(bool is_press)
+Statistics::process_button(bool is_press)
 {
-  lock.lock();
   if (current_day != NULL)
     {
       if (click_x != -1 && click_y != -1 &&
@@ -1079,21 +1495,18 @@ Statistics::button_notify(bool is_press)
           current_day->misc_stats[STATS_VALUE_TOTAL_CLICKS]++;
         }
     }
-  lock.unlock();
 }
 
 
-//! Keyboard activity is reported by the input monitor.
+//! Processes a key press.
 void
-Statistics::keyboard_notify(bool repeat)
+Statistics::process_keyboard(bool repeat)
 {
   if (repeat)
     return;
 
-  lock.lock();
   if (current_day != NULL)
     {
       current_day->misc_stats[STATS_VALUE_TOTAL_KEYSTROKES]++;
     }
-  lock.unlock();
 }
@@ -28,6 +28,7 @@
 
 #include "IStatistics.hh"
 #include "IInputMonitorListener.hh"
+#include "HistoryStore.hh"
 #include "Mutex.hh"
 
 // Forward declarion of external interface.
@@ -66,6 +67,9 @@ private:
       STATS_MARKER_STOPTIME,
       STATS_MARKER_BREAK_STATS,
       STATS_MARKER_MISC_STATS,
+      STATS_MARKER_HISTORY_REQUEST,
+      STATS_MARKER_HISTORY_MORE,
+      STATS_MARKER_HISTORY_NOTICE,
     };
 
 
@@ -99,8 +103,11 @@ private:
       total_mouse_time.tv_usec = 0;
     }
 
-    bool starts_at_date(int y, int m, int d);
-    bool starts_before_date(int y, int m, int d);
+    int get_day_number() const
+    {
+      return HistoryStore::get_day_number(start);
+    }
+
     bool is_empty() const
     {
       return start.tm_year == 0;
@@ -111,6 +118,8 @@ private:
   typedef std::vector<DailyStatsImpl *>::iterator HistoryIter;
   typedef std::vector<DailyStatsImpl *>::reverse_iterator HistoryRIter;
 
+  typedef std::vector<RangeStats> DayTotals;
+
 public:
   //! Constructor.
   Statistics();
@@ -135,22 +144,36 @@ public:
   void get_day_index_by_date(int y, int m, int d, int &idx, int &next, int &prev) const;
 
   int get_history_size() const;
+
+  void get_range_stats(int y1, int m1, int d1, int y2, int m2, int d2, RangeStats &stats) const;
+  void get_week_stats(int y, int m, int d, int week_start, RangeStats &stats) const;
+  void get_month_stats(int y, int m, RangeStats &stats) const;
+  void get_year_stats(int y, RangeStats &stats) const;
+
   void set_counter(StatsValueType t, int value);
   int64_t get_counter(StatsValueType t);
 
+  void process_events();
+
+#ifdef HAVE_DISTRIBUTION
+  void sync_history();
+#endif
+
 private:
-  void action_notify();
-  void mouse_notify(int x, int y, int wheel = 0);
-  void button_notify(bool is_press);
-  void keyboard_notify(bool repeat);
+  void input_events_notify(const InputEvent *events, int count);
+  void wakeup_notify();
+  void process_mouse(int x, int y, int wheel_delta, const GTimeVal &now);
+  void process_button(bool is_press);
+  void process_keyboard(bool repeat);
 
   bool load_current_day();
   void update_current_day(bool active);
   void load_history();
+  void save_history(gint64 source_size);
 
 private:
   void save_day(DailyStatsImpl *stats);
-  void save_day(DailyStatsImpl *stats, std::ofstream &stats_file);
+  void save_day(DailyStatsImpl *stats, std::ostream &stats_file);
   void load(std::ifstream &infile, bool history);
 
   void day_to_history(DailyStatsImpl *stats);
@@ -158,12 +181,20 @@ private:
 
   void add_history(DailyStatsImpl *stats);
 
+  int get_newest_day_number() const;
+  void update_day_totals(int pos);
+  int count_days_until(int day) const;
+  void get_range_stats(int from_day, int to_day, RangeStats &stats) const;
+
 #ifdef HAVE_DISTRIBUTION
   void init_distribution_manager();
   bool request_client_message(DistributionClientMessageID id, PacketBuffer &buffer);
   bool client_message(DistributionClientMessageID id, bool master, const char *client_id,
                       PacketBuffer &buffer);
   bool pack_stats(PacketBuffer &buffer, const DailyStatsImpl *stats);
+  void request_history();
+  void send_history(const std::string &client_id, int day);
+  void remote_day_to_history(DailyStatsImpl *stats);
 #endif
 
 private:
@@ -185,9 +216,23 @@ private:
   //! History
   History history;
 
+  //! Binary copy of the history.
+  HistoryStore history_store;
+
+  //! Day number of the first day in the history.
+  int first_day_number;
+
+  //! Totals of the history up to and including each day since the first day.
+  DayTotals day_totals;
+
   //! Internal locking
   Mutex lock;
 
+#ifdef HAVE_DISTRIBUTION
+  //! Master from which the history is synchronized, or empty if I am the master.
+  std::string history_master;
+#endif
+
   //! Previous X coordinate
   int prev_x;
 
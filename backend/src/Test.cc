@@ -27,12 +27,25 @@
 
 #ifdef HAVE_TESTS
 
+#ifdef PLATFORM_OS_WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
 #include "nls.h"
 
 #include "Test.hh"
 #include "CoreFactory.hh"
 #include "Core.hh"
 #include "IApp.hh"
+#include "PersistenceManager.hh"
+
+#ifdef HAVE_DISTRIBUTION
+#include "DistributionManager.hh"
+#include "FakeActivityMonitor.hh"
+#endif
 
 Test *Test::instance = NULL;
 
@@ -44,4 +57,149 @@ Test::quit()
   core->application->terminate();
 }
 
+
+//! Sets the state of the fake activity monitor (WORKRAVE_FAKE).
+void
+Test::set_activity(bool active)
+{
+#if defined(HAVE_DISTRIBUTION) && !defined(NDEBUG)
+  Core *core = Core::get_instance();
+
+  if (core->fake_monitor != NULL)
+    {
+      core->fake_monitor->set_state(active ? ACTIVITY_ACTIVE : ACTIVITY_IDLE);
+    }
+#else
+  (void) active;
+#endif
+}
+
+
+//! Joins the network at the specified url.
+void
+Test::connect(const std::string &url)
+{
+#ifdef HAVE_DISTRIBUTION
+  Core *core = Core::get_instance();
+
+  if (core->dist_manager != NULL)
+    {
+      core->dist_manager->connect(url);
+    }
+#else
+  (void) url;
+#endif
+}
+
+
+//! Disconnects from all peers.
+void
+Test::disconnect_all()
+{
+#ifdef HAVE_DISTRIBUTION
+  Core *core = Core::get_instance();
+
+  if (core->dist_manager != NULL)
+    {
+      core->dist_manager->disconnect_all();
+    }
+#endif
+}
+
+
+//! Claims to become master.
+void
+Test::claim()
+{
+#ifdef HAVE_DISTRIBUTION
+  Core *core = Core::get_instance();
+
+  if (core->dist_manager != NULL)
+    {
+      core->dist_manager->claim();
+    }
+#endif
+}
+
+
+//! Returns whether this node is master and the number of connected peers.
+void
+Test::get_distribution_state(bool &master, int &peers)
+{
+  master = true;
+  peers = 0;
+
+#ifdef HAVE_DISTRIBUTION
+  Core *core = Core::get_instance();
+
+  if (core->dist_manager != NULL)
+    {
+      master = core->dist_manager->is_master();
+      peers = core->dist_manager->get_number_of_peers();
+    }
+#endif
+}
+
+
+//! Returns the number of packets and bytes sent and received.
+void
+Test::get_packet_counts(int &packets_sent, int &packets_received,
+                        int &bytes_sent, int &bytes_received)
+{
+  packets_sent = 0;
+  packets_received = 0;
+  bytes_sent = 0;
+  bytes_received = 0;
+
+#ifdef HAVE_DISTRIBUTION
+  Core *core = Core::get_instance();
+
+  if (core->dist_manager != NULL)
+    {
+      core->dist_manager->get_packet_counts(packets_sent, packets_received, bytes_sent, bytes_received);
+    }
+#endif
+}
+
+
+//! Returns the processor time used by this node in microseconds.
+gint64
+Test::get_cpu_time()
+{
+#ifdef PLATFORM_OS_WIN32
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+      return 0;
+    }
+
+  // FILETIME is in units of 100 nanoseconds.
+  gint64 kernel = ((gint64)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+  gint64 user = ((gint64)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+  return (kernel + user) / 10;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+
+  return ((gint64)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC
+    + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+
+//! Returns the number of bytes, files and fsyncs written by the background writer.
+void
+Test::get_persistence_counts(gint64 &bytes_written, int &writes, int &skipped, int &fsyncs)
+{
+  PersistenceManager *persistence = Core::get_instance()->get_persistence_manager();
+
+  bytes_written = persistence->get_bytes_written();
+  writes = persistence->get_write_count();
+  skipped = persistence->get_skip_count();
+  fsyncs = persistence->get_fsync_count();
+}
+
 #endif
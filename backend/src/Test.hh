@@ -20,12 +20,33 @@
 #ifndef TEST_H
 #define TEST_H
 
+#include <string>
+
+#include <glib.h>
+
+//! Hooks that let an external script drive and observe this node.
+/*!
+ *  A load test starts several instances, each with its own WORKRAVE_PORT
+ *  and WORKRAVE_FAKE set, and scripts join, claim and disconnect
+ *  scenarios through the debug DBus interface.
+ */
 class Test
 {
 public:
   static Test *get_instance();
 
   void quit();
+
+  void set_activity(bool active);
+  void connect(const std::string &url);
+  void disconnect_all();
+  void claim();
+  void get_distribution_state(bool &master, int &peers);
+  void get_packet_counts(int &packets_sent, int &packets_received,
+                         int &bytes_sent, int &bytes_received);
+  gint64 get_cpu_time();
+  void get_persistence_counts(gint64 &bytes_written, int &writes, int &skipped, int &fsyncs);
+
 private:
   //! The one and only instance
   static Test *instance;
@@ -144,6 +144,7 @@ public:
   time_t get_auto_reset() const;
   TimePred *get_auto_reset_predicate() const;
   time_t get_next_reset_time() const;
+  time_t get_next_pred_reset_time() const;
 
   // Limiting.
   void set_limit(int t);
@@ -37,6 +37,9 @@
 #include "X11InputMonitor.hh"
 #include "XScreenSaverMonitor.hh"
 #include "MutterInputMonitor.hh"
+#ifdef HAVE_XI2
+#include "XI2InputMonitor.hh"
+#endif
 
 UnixInputMonitorFactory::UnixInputMonitorFactory()
   : error_reported(false)
@@ -96,6 +99,12 @@ UnixInputMonitorFactory::get_monitor(IInputMonitorFactory::MonitorCapability cap
             {
               monitor = new RecordInputMonitor(display);
             }
+#ifdef HAVE_XI2
+          else if (actual_monitor_method == "xi2")
+            {
+              monitor = new XI2InputMonitor(display);
+            }
+#endif
           else if (actual_monitor_method == "screensaver")
             {
               monitor = new XScreenSaverMonitor();
@@ -0,0 +1,439 @@
+// XI2InputMonitor.cc --- ActivityMonitor for X11 using XInput2 raw events
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "debug.hh"
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include "XI2InputMonitor.hh"
+
+#include "Thread.hh"
+
+using namespace std;
+
+XI2InputMonitor::XI2InputMonitor(const string &display_name) :
+  x11_display(NULL),
+  xi_opcode(0),
+  abort(false),
+  pressed_key(0),
+  pointer_x(0),
+  pointer_y(0),
+  screen_width(0),
+  screen_height(0)
+{
+  x11_display_name = display_name;
+  abort_pipe[0] = -1;
+  abort_pipe[1] = -1;
+  monitor_thread = new Thread(this);
+}
+
+
+XI2InputMonitor::~XI2InputMonitor()
+{
+  TRACE_ENTER("XI2InputMonitor::~XI2InputMonitor");
+  if (monitor_thread != NULL)
+    {
+      monitor_thread->wait();
+      delete monitor_thread;
+    }
+
+  if (x11_display != NULL)
+    {
+      XCloseDisplay(x11_display);
+    }
+
+  for (int i = 0; i < 2; i++)
+    {
+      if (abort_pipe[i] != -1)
+        {
+          close(abort_pipe[i]);
+        }
+    }
+  TRACE_EXIT();
+}
+
+
+bool
+XI2InputMonitor::init()
+{
+  bool ok = init_xi2();
+  if (ok)
+    {
+      monitor_thread->start();
+    }
+  return ok;
+}
+
+
+void
+XI2InputMonitor::terminate()
+{
+  TRACE_ENTER("XI2InputMonitor::terminate");
+
+  abort = true;
+  if (abort_pipe[1] != -1)
+    {
+      char c = 0;
+      while (write(abort_pipe[1], &c, 1) == -1 && errno == EINTR)
+        ;
+    }
+  monitor_thread->wait();
+
+  TRACE_EXIT();
+}
+
+
+void
+XI2InputMonitor::run()
+{
+  TRACE_ENTER("XI2InputMonitor::run");
+
+  struct pollfd fds[2];
+  fds[0].fd = ConnectionNumber(x11_display);
+  fds[0].events = POLLIN;
+  fds[1].fd = abort_pipe[0];
+  fds[1].events = POLLIN;
+
+  while (!abort)
+    {
+      while (!abort && XPending(x11_display))
+        {
+          XEvent event;
+          XNextEvent(x11_display, &event);
+
+          if (event.type == GenericEvent &&
+              event.xcookie.extension == xi_opcode &&
+              XGetEventData(x11_display, &event.xcookie))
+            {
+              handle_event(&event.xcookie);
+              XFreeEventData(x11_display, &event.xcookie);
+            }
+          else if (event.type == ConfigureNotify)
+            {
+              screen_width = event.xconfigure.width;
+              screen_height = event.xconfigure.height;
+            }
+        }
+
+      // Block until the X server sends something; there is no polling.
+      if (!abort && poll(fds, 2, -1) == -1 && errno != EINTR)
+        {
+          TRACE_MSG("poll failed: " << errno);
+          break;
+        }
+    }
+
+  TRACE_EXIT();
+}
+
+
+//! Initialize the XInput2 monitoring.
+bool
+XI2InputMonitor::init_xi2()
+{
+  TRACE_ENTER("XI2InputMonitor::init_xi2");
+
+  if ((x11_display = XOpenDisplay(x11_display_name.c_str())) == NULL)
+    {
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  int event_base, error_base;
+  if (!XQueryExtension(x11_display, "XInputExtension", &xi_opcode, &event_base, &error_base))
+    {
+      TRACE_MSG("XInput extension not available");
+      XCloseDisplay(x11_display);
+      x11_display = NULL;
+      TRACE_RETURN(false);
+      return false;
+    }
+
+  // Raw events are delivered regardless of grabs since 2.1.
+  int major = 2;
+  int minor = 1;
+  if (XIQueryVersion(x11_display, &major, &minor) != Success || major < 2)
+    {
+      TRACE_MSG("XInput2 not available");
+      XCloseDisplay(x11_display);
+      x11_display = NULL;
+      TRACE_RETURN(false);
+      return false;
+    }
+  TRACE_MSG("XInput version " << major << "." << minor);
+
+  if (pipe(abort_pipe) == -1)
+    {
+      XCloseDisplay(x11_display);
+      x11_display = NULL;
+      TRACE_RETURN(false);
+      return false;
+    }
+  fcntl(abort_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(abort_pipe[1], F_SETFL, O_NONBLOCK);
+
+  Window root = DefaultRootWindow(x11_display);
+
+  XWindowAttributes attrs;
+  XGetWindowAttributes(x11_display, root, &attrs);
+  screen_width = attrs.width;
+  screen_height = attrs.height;
+
+  Window root_return, child_return;
+  int root_x, root_y, win_x, win_y;
+  unsigned int mask;
+  if (XQueryPointer(x11_display, root, &root_return, &child_return,
+                    &root_x, &root_y, &win_x, &win_y, &mask))
+    {
+      pointer_x = root_x;
+      pointer_y = root_y;
+    }
+
+  select_events();
+  XFlush(x11_display);
+
+  TRACE_RETURN(true);
+  return true;
+}
+
+
+//! Selects the raw input events of all devices on the root window.
+void
+XI2InputMonitor::select_events()
+{
+  Window root = DefaultRootWindow(x11_display);
+
+  unsigned char raw_mask[XIMaskLen(XI_LASTEVENT)];
+  memset(raw_mask, 0, sizeof(raw_mask));
+  XISetMask(raw_mask, XI_RawKeyPress);
+  XISetMask(raw_mask, XI_RawKeyRelease);
+  XISetMask(raw_mask, XI_RawButtonPress);
+  XISetMask(raw_mask, XI_RawButtonRelease);
+  XISetMask(raw_mask, XI_RawMotion);
+
+  unsigned char hierarchy_mask[XIMaskLen(XI_LASTEVENT)];
+  memset(hierarchy_mask, 0, sizeof(hierarchy_mask));
+  XISetMask(hierarchy_mask, XI_HierarchyChanged);
+
+  XIEventMask masks[2];
+  masks[0].deviceid = XIAllMasterDevices;
+  masks[0].mask_len = sizeof(raw_mask);
+  masks[0].mask = raw_mask;
+  masks[1].deviceid = XIAllDevices;
+  masks[1].mask_len = sizeof(hierarchy_mask);
+  masks[1].mask = hierarchy_mask;
+
+  XISelectEvents(x11_display, root, masks, 2);
+
+  // Track the size of the root window for relative pointer devices.
+  XSelectInput(x11_display, root, StructureNotifyMask);
+}
+
+
+void
+XI2InputMonitor::handle_event(XGenericEventCookie *cookie)
+{
+  XIRawEvent *event = (XIRawEvent *)cookie->data;
+
+  switch (cookie->evtype)
+    {
+    case XI_RawKeyPress:
+      handle_key_event(event, true);
+      break;
+
+    case XI_RawKeyRelease:
+      handle_key_event(event, false);
+      break;
+
+    case XI_RawButtonPress:
+      handle_button_event(event, true);
+      break;
+
+    case XI_RawButtonRelease:
+      handle_button_event(event, false);
+      break;
+
+    case XI_RawMotion:
+      handle_motion_event(event);
+      break;
+
+    case XI_HierarchyChanged:
+      // Devices were added or removed. Query their axes again when needed.
+      device_axes.clear();
+      break;
+    }
+}
+
+
+void
+XI2InputMonitor::handle_key_event(XIRawEvent *event, bool is_press)
+{
+  if (is_press)
+    {
+      // Auto-repeat sends presses without releases in between.
+      fire_keyboard(event->detail == pressed_key);
+      pressed_key = event->detail;
+    }
+  else if (event->detail == pressed_key)
+    {
+      pressed_key = 0;
+    }
+}
+
+
+void
+XI2InputMonitor::handle_button_event(XIRawEvent *event, bool is_press)
+{
+  if (event->detail >= 4 && event->detail <= 7)
+    {
+      // Buttons 4-7 are the scroll wheel.
+      if (is_press)
+        {
+          int wheel = (event->detail == 4 || event->detail == 6) ? -1 : 1;
+          fire_mouse((int)pointer_x, (int)pointer_y, wheel);
+        }
+    }
+  else
+    {
+      fire_button(is_press);
+    }
+}
+
+
+void
+XI2InputMonitor::handle_motion_event(XIRawEvent *event)
+{
+  const DeviceAxes &axes = get_device_axes(event->sourceid);
+  double *values = event->valuators.values;
+  bool moved = false;
+
+  // Only the valuators that are set in the mask are present in values.
+  for (int i = 0; i < event->valuators.mask_len * 8 && i < 2; i++)
+    {
+      if (!XIMaskIsSet(event->valuators.mask, i))
+        {
+          continue;
+        }
+
+      double value = *values++;
+      double &pos = (i == 0) ? pointer_x : pointer_y;
+      int size = (i == 0) ? screen_width : screen_height;
+
+      if (axes.absolute)
+        {
+          const Axis &axis = (i == 0) ? axes.x : axes.y;
+          if (axis.max > axis.min)
+            {
+              pos = (value - axis.min) * size / (axis.max - axis.min);
+            }
+        }
+      else
+        {
+          pos += value;
+        }
+
+      if (pos < 0)
+        {
+          pos = 0;
+        }
+      else if (size > 0 && pos > size - 1)
+        {
+          pos = size - 1;
+        }
+      moved = true;
+    }
+
+  if (moved)
+    {
+      fire_mouse((int)pointer_x, (int)pointer_y, 0);
+    }
+  else
+    {
+      fire_action();
+    }
+}
+
+
+//! Returns the horizontal and vertical axes of the specified device.
+const XI2InputMonitor::DeviceAxes &
+XI2InputMonitor::get_device_axes(int deviceid)
+{
+  DeviceAxesMap::iterator it = device_axes.find(deviceid);
+  if (it != device_axes.end())
+    {
+      return it->second;
+    }
+
+  DeviceAxes &axes = device_axes[deviceid];
+  axes.absolute = false;
+  axes.x.min = axes.x.max = 0;
+  axes.y.min = axes.y.max = 0;
+
+  // Query all devices; querying a single device that was just removed
+  // results in a BadDevice error.
+  int num_devices = 0;
+  XIDeviceInfo *devices = XIQueryDevice(x11_display, XIAllDevices, &num_devices);
+
+  for (int i = 0; devices != NULL && i < num_devices; i++)
+    {
+      if (devices[i].deviceid != deviceid)
+        {
+          continue;
+        }
+
+      for (int j = 0; j < devices[i].num_classes; j++)
+        {
+          XIAnyClassInfo *info = devices[i].classes[j];
+          if (info->type != XIValuatorClass)
+            {
+              continue;
+            }
+
+          XIValuatorClassInfo *valuator = (XIValuatorClassInfo *)info;
+          if (valuator->number == 0 || valuator->number == 1)
+            {
+              Axis &axis = (valuator->number == 0) ? axes.x : axes.y;
+              axis.min = valuator->min;
+              axis.max = valuator->max;
+              axes.absolute = (valuator->mode == XIModeAbsolute);
+            }
+        }
+    }
+
+  if (devices != NULL)
+    {
+      XIFreeDeviceInfo(devices);
+    }
+
+  return axes;
+}
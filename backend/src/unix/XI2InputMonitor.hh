@@ -0,0 +1,124 @@
+// XI2InputMonitor.hh --- ActivityMonitor for X11 using XInput2 raw events
+//
+// Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef XI2INPUTMONITOR_HH
+#define XI2INPUTMONITOR_HH
+
+#include <string>
+#include <map>
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include "InputMonitor.hh"
+
+#include "Runnable.hh"
+#include "Thread.hh"
+
+//! Activity monitor for a local X server.
+/*!
+ *  Receives raw key, button and motion events of all devices from the
+ *  XInput2 extension. Unlike the x11events monitor, no window tree needs
+ *  to be walked and no pointer polling is needed: the monitor thread
+ *  blocks until the X server sends an event.
+ */
+class XI2InputMonitor :
+  public InputMonitor,
+  public Runnable
+{
+public:
+  //! Constructor.
+  XI2InputMonitor(const std::string &display_name);
+
+  //! Destructor.
+  virtual ~XI2InputMonitor();
+
+  //! Initialize
+  virtual bool init();
+
+  //! Terminate the monitor.
+  virtual void terminate();
+
+private:
+  //! Absolute axis of a device.
+  struct Axis
+  {
+    double min;
+    double max;
+  };
+
+  //! Horizontal and vertical axes of a device.
+  struct DeviceAxes
+  {
+    bool absolute;
+    Axis x;
+    Axis y;
+  };
+
+  typedef std::map<int, DeviceAxes> DeviceAxesMap;
+
+  //! The monitor's execution thread.
+  virtual void run();
+
+  bool init_xi2();
+  void select_events();
+
+  void handle_event(XGenericEventCookie *cookie);
+  void handle_key_event(XIRawEvent *event, bool is_press);
+  void handle_button_event(XIRawEvent *event, bool is_press);
+  void handle_motion_event(XIRawEvent *event);
+
+  const DeviceAxes &get_device_axes(int deviceid);
+
+private:
+  //! The X11 display name.
+  std::string x11_display_name;
+
+  //! The X11 display handle.
+  Display *x11_display;
+
+  //! Major opcode of the XInput extension.
+  int xi_opcode;
+
+  //! Pipe used to wake up the monitor thread on termination.
+  int abort_pipe[2];
+
+  //! Abort the main loop
+  volatile bool abort;
+
+  //! The activity monitor thread.
+  Thread *monitor_thread;
+
+  //! Keycode of the last pressed key that was not released yet.
+  int pressed_key;
+
+  //! Axes of the slave devices, indexed by device id.
+  DeviceAxesMap device_axes;
+
+  //! Last known pointer position.
+  double pointer_x;
+  double pointer_y;
+
+  //! Size of the root window.
+  int screen_width;
+  int screen_height;
+};
+
+#endif // XI2INPUTMONITOR_HH
@@ -0,0 +1,243 @@
+#!/usr/bin/python
+#
+# distribution_load.py --- Load test of the distribution protocol
+#
+# Copyright (C) 2013 Rob Caelers <robc@krandor.nl>
+# All rights reserved.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Starts several workrave instances on the loopback interface and runs
+# join, claim, disconnect and failover scenarios through the debug DBus
+# interface. For each scenario, the time until the network converged and
+# the packets, bytes and processor time used per node are reported.
+# Finally, the traffic of the periodic state sync of an idle network is
+# measured. Run once with and once without --full-state to compare the
+# bytes on the wire of delta and full state syncs.
+#
+# Requires a build configured with --enable-tests, --enable-distribution and
+# --enable-app-text, and a running session bus. Run from the top of the
+# build tree:
+#
+#   python backend/test/distribution_load.py [--full-state] [nodes]
+
+import os
+import sys
+import time
+import shutil
+import subprocess
+import dbus
+
+BASE_PORT = 27400
+TIMEOUT = 60.0
+POLL_INTERVAL = 0.05
+
+# Covers three periodic state syncs of the master.
+SYNC_TIME = 95.0
+
+bus = dbus.SessionBus()
+
+
+class Node:
+
+    def __init__(self, index, full_state):
+        self.index = index
+        self.full_state = full_state
+        self.name = "org.workrave.Workrave" + str(index)
+        self.port = BASE_PORT + index
+        self.home = "/tmp/workrave-load" + str(index) + "/"
+        self.process = None
+        self.debug = None
+        self.config = None
+
+    def start(self):
+        shutil.rmtree(self.home, True)
+        os.makedirs(self.home)
+
+        env = dict(os.environ)
+        env["WORKRAVE_TEST"] = "1"
+        env["WORKRAVE_FAKE"] = "1"
+        env["WORKRAVE_HOME"] = self.home
+        env["WORKRAVE_PORT"] = str(self.port)
+        env["WORKRAVE_DBUS_NAME"] = self.name
+        if self.full_state:
+            env["WORKRAVE_FULL_STATE"] = "1"
+
+        log = open(self.home + "out.log", "w")
+        self.process = subprocess.Popen([os.getcwd() + "/frontend/text/src/workrave"],
+                                        env = env, stdout = log, stderr = log)
+
+    def attach(self):
+        deadline = time.time() + TIMEOUT
+        while True:
+            try:
+                core = bus.get_object(self.name, "/org/workrave/Workrave/Core")
+                debug = bus.get_object(self.name, "/org/workrave/Workrave/Debug")
+                self.config = dbus.Interface(core, "org.workrave.ConfigInterface")
+                self.debug = dbus.Interface(debug, "org.workrave.DebugInterface")
+                self.debug.GetCpuTime()
+                return
+            except dbus.DBusException:
+                if time.time() > deadline:
+                    raise
+                time.sleep(0.1)
+
+    def configure(self):
+        self.config.SetBool("distribution/enabled", True)
+        self.config.SetBool("distribution/listening", True)
+        self.config.SetBool("distribution/discovery", False)
+        self.debug.SetActivity(True)
+
+    def running(self):
+        return self.process is not None and self.process.poll() is None
+
+    def stop(self):
+        if self.running():
+            try:
+                self.debug.Quit()
+                self.process.wait()
+            except dbus.DBusException:
+                self.process.kill()
+        self.process = None
+
+    def state(self):
+        master, peers = self.debug.GetDistributionState()
+        return bool(master), int(peers)
+
+    def counters(self):
+        packets_sent, packets_received, bytes_sent, bytes_received = self.debug.GetPacketCounts()
+        return [int(packets_sent), int(packets_received),
+                int(bytes_sent), int(bytes_received), int(self.debug.GetCpuTime())]
+
+
+def live(nodes):
+    return [n for n in nodes if n.running()]
+
+
+def wait_until(nodes, converged):
+    """Polls the state of all live nodes until converged() accepts it."""
+    start = time.time()
+    while time.time() - start < TIMEOUT:
+        states = dict((n.index, n.state()) for n in live(nodes))
+        if converged(states):
+            return time.time() - start
+        time.sleep(POLL_INTERVAL)
+    return None
+
+
+def single_master(states):
+    return len([s for s in states.values() if s[0]]) == 1
+
+
+def run_scenario(name, nodes, action, converged):
+    before = dict((n.index, n.counters()) for n in live(nodes))
+    action()
+    elapsed = wait_until(nodes, converged)
+
+    print
+    if elapsed is None:
+        print "%s: did not converge within %.0f s" % (name, TIMEOUT)
+    else:
+        print "%s: converged in %.3f s" % (name, elapsed)
+
+    report(nodes, before)
+
+
+def run_idle(name, nodes, seconds):
+    before = dict((n.index, n.counters()) for n in live(nodes))
+    time.sleep(seconds)
+
+    print
+    print "%s: %.0f s" % (name, seconds)
+
+    report(nodes, before)
+
+
+def report(nodes, before):
+    """Prints the counters of all live nodes relative to before."""
+    total = 0
+    print "  %-6s %10s %10s %12s %12s %10s" % ("node", "pkts out", "pkts in",
+                                               "bytes out", "bytes in", "cpu ms")
+    for n in live(nodes):
+        after = n.counters()
+        delta = [a - b for a, b in zip(after, before.get(n.index, [0] * 5))]
+        print "  %-6d %10d %10d %12d %12d %10.1f" % (n.index, delta[0], delta[1],
+                                                     delta[2], delta[3], delta[4] / 1000.0)
+        total += delta[2]
+    print "  total bytes out: %d" % total
+
+
+def main():
+    args = sys.argv[1:]
+    full_state = "--full-state" in args
+    if full_state:
+        args.remove("--full-state")
+
+    count = 4
+    if len(args) > 0:
+        count = int(args[0])
+    if count < 3:
+        print "At least 3 nodes are needed"
+        return 1
+
+    nodes = [Node(i, full_state) for i in range(count)]
+    try:
+        for n in nodes:
+            n.start()
+        for n in nodes:
+            n.attach()
+            n.configure()
+
+        first = nodes[0]
+        last = nodes[-1]
+
+        def join():
+            for n in nodes[1:]:
+                n.debug.Connect("tcp://localhost:" + str(first.port))
+
+        run_scenario("join", nodes, join,
+                     lambda s: single_master(s) and s[first.index][1] == count - 1
+                               and min(p for m, p in s.values()) >= 1)
+
+        run_scenario("claim", nodes, last.debug.Claim,
+                     lambda s: single_master(s) and s[last.index][0])
+
+        def disconnect():
+            nodes[1].debug.DisconnectAll()
+
+        run_scenario("disconnect", nodes, disconnect,
+                     lambda s: s[nodes[1].index][1] == 0
+                               and single_master(dict((i, v) for i, v in s.items()
+                                                      if i != nodes[1].index)))
+
+        nodes[1].debug.Connect("tcp://localhost:" + str(first.port))
+        wait_until(nodes, lambda s: min(p for m, p in s.values()) >= 1 and single_master(s))
+
+        master = [n for n in nodes if n.state()[0]][0]
+        run_scenario("failover", nodes, master.stop,
+                     lambda s: single_master(s))
+
+        if full_state:
+            run_idle("sync (full state)", nodes, SYNC_TIME)
+        else:
+            run_idle("sync (delta state)", nodes, SYNC_TIME)
+    finally:
+        for n in nodes:
+            n.stop()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
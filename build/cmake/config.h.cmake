@@ -323,6 +323,9 @@
 
 #define HAVE_STRUCT_MOUSEHOOKSTRUCTEX
 
+/* Define to 1 if you have the <sys/epoll.h> header file. */
+/* #undef HAVE_SYS_EPOLL_H */
+
 /* Define to 1 if you have the <sys/param.h> header file. */
 #define HAVE_SYS_PARAM_H 1
 
@@ -348,7 +348,7 @@ ${interface.qname}_Stub::put_${dict.qname}(DBusMessageIter *writer, const ${dict
   dbus_bool_t ok;
 
   ok = dbus_message_iter_open_container(writer, DBUS_TYPE_ARRAY,
-                                        "$interface.type2sig(dict.value_type)", &arr_it);
+                                        "{$interface.type2sig(dict.key_type)$interface.type2sig(dict.value_type)}", &arr_it);
   if (!ok)
     {
       throw DBusSystemException("Internal error");
@@ -346,8 +346,8 @@ ${interface.qname}_Stub::get_${dict.qname}(GVariant *variant, ${dict.csymbol} *r
 }
 
 
-void
-${interface.qname}_Stub::put_${dict.qname}(GVariant *variant, const ${dict.csymbol} *result)
+GVariant *
+${interface.qname}_Stub::put_${dict.qname}(const ${dict.csymbol} *result)
 {
   GVariantBuilder builder;
   g_variant_builder_init(&builder, (GVariantType *)"$dict.sig()");
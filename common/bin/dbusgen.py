@@ -394,7 +394,7 @@ class DictionaryNode(NodeBase):
         self.parent.types[self.name] = self
 
     def sig(self):
-        return 'e{' + \
+        return 'a{' + \
                self.parent.type2sig(self.key_type) + \
                self.parent.type2sig(self.value_type) + '}'
 
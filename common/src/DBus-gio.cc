@@ -340,7 +340,7 @@ DBus::on_bus_name_vanished(GDBusConnection *connection, const gchar *name, gpoin
 void
 DBus::bus_name_presence(const std::string &name, bool present)
 {
-  if (watched.find(name) != watched.end())
+  if (watched.find(name) != watched.end() && watched[name].callback != NULL)
     {
       watched[name].callback->bus_name_presence(name, present);
     }
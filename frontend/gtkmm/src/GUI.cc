@@ -141,7 +141,9 @@ GUI::GUI(int argc, char **argv) :
   status_icon(NULL),
   applet_control(NULL),
   muted(false),
-  closewarn_shown(false)
+  closewarn_shown(false),
+  heartbeat_sleeping(false),
+  wakeup_dispatcher(NULL)
 {
   TRACE_ENTER("GUI:GUI");
 
@@ -176,6 +178,7 @@ GUI::~GUI()
   delete [] heads;
 
   delete sound_player;
+  delete wakeup_dispatcher;
 
   TRACE_EXIT();
 }
@@ -345,7 +348,56 @@ GUI::on_timer()
         }
     }
 
-  return true;
+  return schedule_heartbeat();
+}
+
+
+//! Schedules the next heartbeat.
+/*!
+ *  While nothing is shown that changes every second, the heartbeat sleeps
+ *  until the next deadline of the core. Returns whether the current
+ *  heartbeat timer must be kept.
+ */
+bool
+GUI::schedule_heartbeat()
+{
+  bool keep = true;
+  time_t now = core->get_time();
+  time_t next = core->get_next_heartbeat_time();
+
+  bool can_sleep = (next > now + 1 &&
+                    active_break_count == 0 && active_prelude_count == 0 &&
+                    !main_window->is_visible() && !applet_control->is_visible());
+
+  if (can_sleep)
+    {
+      TRACE_ENTER_MSG("GUI::schedule_heartbeat", next - now);
+      heartbeat_connection.disconnect();
+      heartbeat_connection = Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &GUI::on_timer), next - now);
+      heartbeat_sleeping = true;
+      keep = false;
+      TRACE_EXIT();
+    }
+  else if (heartbeat_sleeping || !heartbeat_connection.connected())
+    {
+      heartbeat_connection.disconnect();
+      heartbeat_connection = Glib::signal_timeout().connect(sigc::mem_fun(*this, &GUI::on_timer), 1000);
+      heartbeat_sleeping = false;
+      keep = false;
+    }
+
+  return keep;
+}
+
+
+//! Activity after a period of idleness was detected.
+void
+GUI::on_wakeup()
+{
+  if (heartbeat_sleeping)
+    {
+      on_timer();
+    }
 }
 
 #if defined(NDEBUG)
@@ -819,7 +871,10 @@ GUI::init_gui()
 #endif
 
   // Periodic timer.
-  Glib::signal_timeout().connect(sigc::mem_fun(*this, &GUI::on_timer), 1000);
+  heartbeat_connection = Glib::signal_timeout().connect(sigc::mem_fun(*this, &GUI::on_timer), 1000);
+
+  wakeup_dispatcher = new Glib::Dispatcher();
+  wakeup_dispatcher->connect(sigc::mem_fun(*this, &GUI::on_wakeup));
 }
 
 
@@ -992,6 +1047,17 @@ GUI::core_event_usage_mode_changed(const UsageMode m)
   menus->resync();
 }
 
+
+//! Wakes up the heartbeat. Called from the input monitor thread.
+void
+GUI::core_event_wakeup()
+{
+  if (wakeup_dispatcher != NULL)
+    {
+      wakeup_dispatcher->emit();
+    }
+}
+
 void
 GUI::config_changed_notify(const std::string &key)
 {
@@ -118,6 +118,7 @@ public:
   void core_event_notify(const CoreEvent event);
   void core_event_operation_mode_changed(const OperationMode m);
   void core_event_usage_mode_changed(const UsageMode m);
+  void core_event_wakeup();
 
   virtual void bus_name_presence(const std::string &name, bool present);
   
@@ -140,6 +141,8 @@ public:
 private:
   std::string get_timers_tooltip();
   bool on_timer();
+  bool schedule_heartbeat();
+  void on_wakeup();
   void init_platform();
   void init_debug();
   void init_nls();
@@ -272,6 +275,15 @@ private:
 
   // UI Event connections
   std::list<sigc::connection> event_connections;
+
+  //! Connection to the heartbeat timer.
+  sigc::connection heartbeat_connection;
+
+  //! Is the heartbeat timer waiting for the next deadline of the core?
+  bool heartbeat_sleeping;
+
+  //! Wakes up the heartbeat from the input monitor thread.
+  Glib::Dispatcher *wakeup_dispatcher;
   
 };
 
@@ -509,42 +509,11 @@ StatisticsDialog::display_week_statistics()
   guint y, m, d;
   calendar->get_date(y, m, d);
 
-  std::tm timeinfo;
-  std::memset(&timeinfo, 0, sizeof(timeinfo));
-  timeinfo.tm_mday = d;
-  timeinfo.tm_mon = m;
-  timeinfo.tm_year = y - 1900;
-
-  std::time_t t = std::mktime(&timeinfo);
-  std::tm const *time_loc = std::localtime(&t);
-
-  int offset = (time_loc->tm_wday - Locale::get_week_start() + 7) % 7;
-  int64_t total_week = 0;
-  for (int i = 0; i < 7; i++)
-    {
-      std::memset(&timeinfo, 0, sizeof(timeinfo));
-      timeinfo.tm_mday = d - offset + i;
-      timeinfo.tm_mon = m;
-      timeinfo.tm_year = y - 1900;
-      t = std::mktime(&timeinfo);
-      time_loc = std::localtime(&t);
-
-      int idx, next, prev;
-      statistics->get_day_index_by_date(time_loc->tm_year + 1900,
-                                        time_loc->tm_mon + 1,
-                                        time_loc->tm_mday, idx, next, prev);
-
-      if (idx >= 0)
-        {
-          IStatistics::DailyStats *stats = statistics->get_day(idx);
-          if (stats != NULL)
-            {
-              total_week += stats->misc_stats[IStatistics::STATS_VALUE_TOTAL_ACTIVE_TIME];
-            }
+  IStatistics::RangeStats stats;
+  statistics->get_week_stats(y, m + 1, d, Locale::get_week_start(), stats);
 
-          update_usage_real_time |= (idx == 0);
-        }
-    }
+  int64_t total_week = stats.misc_stats[IStatistics::STATS_VALUE_TOTAL_ACTIVE_TIME];
+  update_usage_real_time |= stats.includes_current_day;
 
   weekly_usage_time_label->set_text(total_week > 0 ? Text::time_to_string(total_week) : "");
 }
@@ -554,44 +523,11 @@ StatisticsDialog::display_month_statistics() {
   guint y, m, d;
   calendar->get_date(y, m, d);
 
-  guint max_mday;
-  if (m == 3 || m == 5 || m == 8 || m == 10)
-    {
-      max_mday = 30;
-    }
-  else if (m == 1)
-    {
-      bool is_leap = (y % 4 == 0 && y % 100 != 0) || (y % 400 == 0);
-      if (is_leap)
-        {
-          max_mday = 29;
-        }
-      else
-        {
-          max_mday = 28;
-        }
-    }
-  else
-    {
-      max_mday = 31;
-    }
-
-  int64_t total_month = 0;
-  for (guint i = 1; i <= max_mday; i++)
-    {
-      int idx, next, prev;
-      statistics->get_day_index_by_date(y, m + 1, i, idx, next, prev);
-      if (idx >= 0)
-        {
-          IStatistics::DailyStats *stats = statistics->get_day(idx);
-          if (stats != NULL)
-            {
-              total_month += stats->misc_stats[IStatistics::STATS_VALUE_TOTAL_ACTIVE_TIME];
-            }
+  IStatistics::RangeStats stats;
+  statistics->get_month_stats(y, m + 1, stats);
 
-          update_usage_real_time |= (idx == 0);
-        }
-    }
+  int64_t total_month = stats.misc_stats[IStatistics::STATS_VALUE_TOTAL_ACTIVE_TIME];
+  update_usage_real_time |= stats.includes_current_day;
 
   monthly_usage_time_label->set_text(total_month > 0 ? Text::time_to_string(total_month) : "");
 }
@@ -108,7 +108,7 @@ GUI::~GUI()
 void
 GUI::restbreak_now()
 {
-  core->force_break(BREAK_ID_REST_BREAK, true);
+  core->force_break(BREAK_ID_REST_BREAK, BREAK_HINT_USER_INITIATED);
 }
 
 
@@ -121,6 +121,16 @@ GUI::static_on_timer(gpointer data)
 }
 
 
+//! Performs an early heartbeat after a wakeup request.
+gboolean
+GUI::static_on_wakeup(gpointer data)
+{
+  GUI *gui = (GUI*) data;
+  gui->on_timer();
+  return false;
+}
+
+
 //! The main entry point.
 void
 GUI::main()
@@ -300,15 +310,30 @@ GUI::core_event_operation_mode_changed(const OperationMode m)
   (void) m;
 }
 
+
+void
+GUI::core_event_usage_mode_changed(const UsageMode m)
+{
+  (void) m;
+}
+
+
+//! Wakes up the heartbeat. Called from the input monitor thread.
+void
+GUI::core_event_wakeup()
+{
+  g_idle_add(static_on_wakeup, this);
+}
+
 //! Returns a break window for the specified break.
 IBreakWindow *
-GUI::new_break_window(BreakId break_id, bool user_initiated)
+GUI::new_break_window(BreakId break_id, BreakHint break_hint)
 {
   IBreakWindow *ret = NULL;
   BlockMode block_mode = get_block_mode();
   bool ignorable = true;
 
-  (void) user_initiated;
+  (void) break_hint;
 
   if (break_id == BREAK_ID_MICRO_BREAK)
     {
@@ -357,7 +382,7 @@ GUI::create_break_window(BreakId break_id, BreakHint break_hint)
 
   active_break_id = break_id;
 
-  break_window = new_break_window(break_id, ignorable);
+  break_window = new_break_window(break_id, break_hint);
   break_window->set_response(response);
 
   if (get_block_mode() != GUI::BLOCK_MODE_NONE)
@@ -69,10 +69,13 @@ public:
   //
   void core_event_notify(CoreEvent event);
   void core_event_operation_mode_changed(const OperationMode m);
+  void core_event_usage_mode_changed(const UsageMode m);
+  void core_event_wakeup();
 
   SoundPlayer *get_sound_player() const;
 
   static gboolean static_on_timer(gpointer data);
+  static gboolean static_on_wakeup(gpointer data);
 
   enum BlockMode { BLOCK_MODE_NONE = 0, BLOCK_MODE_INPUT, BLOCK_MODE_ALL };
 
@@ -85,7 +88,7 @@ private:
   void init_sound_player();
 
   void collect_garbage();
-  IBreakWindow *new_break_window(BreakId break_id, bool ignorable);
+  IBreakWindow *new_break_window(BreakId break_id, BreakHint break_hint);
 
   // Prefs
   static const std::string CFG_KEY_GUI_BLOCK_MODE;